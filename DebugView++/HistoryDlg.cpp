@@ -71,8 +71,7 @@ void CHistoryDlg::OnCancel(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl*/)
 
 void CHistoryDlg::OnOk(UINT /*uNotifyCode*/, int nID, CWindow /*wndCtl*/)
 {
-    m_historySize = GetDlgItemInt(IDC_HISTORY);
-    //    m_unlimited = fusion::GetDlgItemText(*this, IDC_ARGUMENTS);
+    m_historySize = m_unlimited ? 0 : GetDlgItemInt(IDC_HISTORY);
 
     EndDialog(nID);
 }
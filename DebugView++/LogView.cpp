@@ -117,10 +117,20 @@ Highlight::Highlight(int id, int begin, int end, const TextColor& color) :
 
 LogLine::LogLine(int line) :
     bookmark(false),
+    color(-1),
     line(line)
 {
 }
 
+FilterRescan::FilterRescan(const LogFile& logFile, const LogFilter& filter, LineQuery query, int beginLine, size_t chunks) :
+    scan(logFile, filter, std::move(query), beginLine, chunks),
+    beginLine(beginLine),
+    focusLine(-1),
+    bookmark(0),
+    previousEnd(0)
+{
+}
+
 ItemData::ItemData() :
     color(Colors::BackGround, Colors::Text)
 {
@@ -223,6 +233,7 @@ CLogView::CLogView(std::wstring name, CMainFrame& mainFrame, LogFile& logFile, L
     m_logFile(logFile),
     m_filter(std::move(filter)),
     m_firstLine(0),
+    m_trimmedLines(0),
     m_clockTime(false),
     m_processColors(false),
     m_autoScrollDown(true),
@@ -621,6 +632,15 @@ void CLogView::OnLButtonUp(UINT /*flags*/, CPoint point)
 
 void CLogView::OnTimer(UINT_PTR nIDEvent)
 {
+    if (nIDEvent == 2)
+    {
+        if (m_rescan)
+        {
+            ScanLines();
+        }
+        return;
+    }
+
     if (nIDEvent != 1)
     {
         return;
@@ -894,10 +914,11 @@ ItemData CLogView::GetItemData(int iItem) const
     data.text[Column::Time] = GetItemWText(iItem, ColumnToSubItem(Column::Time));
     data.text[Column::Pid] = GetItemWText(iItem, ColumnToSubItem(Column::Pid));
     data.text[Column::Process] = GetItemWText(iItem, ColumnToSubItem(Column::Process));
-    auto text = TabsToSpaces(m_logFile[m_logLines[iItem].line].text);
-    data.highlights = GetHighlights(WStr(m_logFile[m_logLines[iItem].line].text).str());
+    auto msg = m_logFile.GetMessageRef(m_logLines[iItem].line);
+    auto text = TabsToSpaces(msg.text);
+    data.highlights = GetHighlights(WStr(msg.text).str());
     data.text[Column::Message] = WStr(text).str();
-    data.color = GetTextColor(m_logFile[m_logLines[iItem].line]);
+    data.color = GetTextColor(msg, m_logLines[iItem].color);
     return data;
 }
 
@@ -969,7 +990,7 @@ void CLogView::DrawItem(CDCHandle dc, int iItem, unsigned /*iItemState*/) const
 std::wstring CLogView::GetColumnText(int iItem, Column::type column) const
 {
     int line = m_logLines[iItem].line;
-    const Message& msg = m_logFile[line];
+    auto msg = m_logFile.GetMessageRef(line);
 
     switch (column)
     {
@@ -1027,7 +1048,7 @@ SelectionInfo CLogView::GetViewRange() const
     return SelectionInfo(m_logLines.front().line, m_logLines.back().line, static_cast<int>(m_logLines.size()));
 }
 
-bool Contains(const std::string& text, const std::string& substring)
+bool Contains(std::string_view text, std::string_view substring)
 {
     return !boost::algorithm::ifind_first(text, substring).empty();
 }
@@ -1042,7 +1063,7 @@ LRESULT CLogView::OnIncrementalSearch(NMHDR* pnmh)
     int line = std::max(GetNextItem(-1, LVNI_FOCUSED), 0);
     while (line != static_cast<int>(m_logLines.size()))
     {
-        if (Contains(m_logFile[m_logLines[line].line].text, text))
+        if (Contains(m_logFile.GetMessageRef(m_logLines[line].line).text, text))
         {
             SetHighlightText(nmhdr.lvfi.psz);
             nmhdr.lvfi.lParam = line;
@@ -1055,9 +1076,27 @@ LRESULT CLogView::OnIncrementalSearch(NMHDR* pnmh)
     return 0;
 }
 
+// the listview is about to paint items [iFrom, iTo], decode their storage blocks and
+// those of one page above and below in the background so scrolling hits the block cache
 LRESULT CLogView::OnOdCacheHint(NMHDR* pnmh)
 {
-    [[maybe_unused]] auto& nmhdr = *reinterpret_cast<NMLVCACHEHINT*>(pnmh);
+    auto& nmhdr = *reinterpret_cast<NMLVCACHEHINT*>(pnmh);
+    int size = static_cast<int>(m_logLines.size());
+    if (nmhdr.iFrom < 0 || nmhdr.iFrom >= size || nmhdr.iTo < nmhdr.iFrom)
+    {
+        return 0;
+    }
+
+    int page = nmhdr.iTo - nmhdr.iFrom + 1;
+    auto prefetch = [this](int from, int to) {
+        for (int item = from; item <= to; ++item)
+        {
+            m_logFile.Prefetch(m_logLines[item].line, m_logLines[item].line);
+        }
+    };
+    prefetch(nmhdr.iFrom, std::min(nmhdr.iTo, size - 1));
+    prefetch(nmhdr.iTo + 1, std::min(nmhdr.iTo + page, size - 1));
+    prefetch(std::max(nmhdr.iFrom - page, 0), nmhdr.iFrom - 1);
     return 0;
 }
 
@@ -1118,11 +1157,12 @@ void CLogView::OnViewExcludeLines(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*w
 {
     auto messages = GetSelectedMessages();
     int size = std::min(100, static_cast<int>(messages.size()));
+    auto filter = m_filter;
     for (int i = 0; i < size; ++i)
     {
-        m_filter.messageFilters.emplace_back(messages[i], MatchType::Simple, FilterType::Exclude, RGB(255, 255, 255), RGB(0, 0, 0));
+        filter.messageFilters.emplace_back(messages[i], MatchType::Simple, FilterType::Exclude, RGB(255, 255, 255), RGB(0, 0, 0));
     }
-    ApplyFilters();
+    ApplyFilters(std::move(filter));
 }
 
 void CLogView::OnViewSelectAll(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
@@ -1162,6 +1202,12 @@ void CLogView::OnViewProcessColors(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*
 
 void CLogView::OnEscapeKey(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
 {
+    if (IsFiltering())
+    {
+        CancelFiltering();
+        return;
+    }
+
     SetHighlightText(L"");
     StopScrolling();
 }
@@ -1191,7 +1237,9 @@ bool CLogView::FindProcess(int direction)
     }
 
     auto processName = m_logFile[m_logLines[begin].line].processName;
-    int line = FindLine([processName, this](const LogLine& line) { return m_logFile[line.line].processName == processName; }, direction);
+    LineQuery query;
+    query.processFilter = [&processName](std::string_view name) { return name == processName; };
+    int line = FindLine([&processName, &query, this](const LogLine& line) { return m_logFile.MayMatch(line.line, query) && m_logFile.GetMessageRef(line.line).processName == processName; }, direction);
     if (line < 0 || line == begin)
     {
         return false;
@@ -1221,12 +1269,13 @@ void CLogView::AddProcessFilter(FilterType::type filterType, COLORREF bgColor, C
         names.insert(m_logFile[m_logLines[item].line].processName);
     }
 
+    auto filter = m_filter;
     for (auto& name : names)
     {
-        m_filter.processFilters.emplace_back(Str(name), MatchType::Simple, filterType, bgColor, fgColor);
+        filter.processFilters.emplace_back(Str(name), MatchType::Simple, filterType, bgColor, fgColor);
     }
 
-    ApplyFilters();
+    ApplyFilters(std::move(filter));
 }
 
 void CLogView::OnViewProcessRename(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
@@ -1279,8 +1328,9 @@ void CLogView::AddMessageFilter(FilterType::type filterType, COLORREF bgColor, C
         return;
     }
 
-    m_filter.messageFilters.emplace_back(Str(m_highlightText), MatchType::Simple, filterType, bgColor, fgColor);
-    ApplyFilters();
+    auto filter = m_filter;
+    filter.messageFilters.emplace_back(Str(m_highlightText), MatchType::Simple, filterType, bgColor, fgColor);
+    ApplyFilters(std::move(filter));
 }
 
 void CLogView::OnViewFilterHighlight(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/)
@@ -1454,17 +1504,29 @@ const std::vector<ColumnInfo>& CLogView::GetColumns() const
 
 void CLogView::Clear()
 {
-    m_firstLine = m_logFile.Count();
+    if (m_rescan)
+    {
+        KillTimer(2);
+        m_rescan.reset();
+    }
+
+    ClearLines(m_logFile.EndIndex());
+    ResetFilters();
+}
+
+// FilterProgram::Run() already reset the filters for a Clear line, here only the lines are dropped
+void CLogView::ClearLines(int firstLine)
+{
+    m_firstLine = firstLine;
     SetItemCount(0);
     m_dirty = false;
     m_logLines.clear();
+    m_trimmedLines = 0;
     m_highlightText.clear();
     if (m_autoScrollStop)
     {
         m_autoScrollDown = true;
     }
-
-    ResetFilters();
 }
 
 int CLogView::GetFocusLine() const
@@ -1484,52 +1546,96 @@ void CLogView::SetFocusLine(int line)
     ScrollToIndex(static_cast<int>(it - m_logLines.begin() - 1), false);
 }
 
-void CLogView::Add(int beginIndex, int line, const Message& msg)
+// returns the item that shows 'line', or -1 when the line is not in the view
+int CLogView::LineToItem(int line) const
 {
-    if (IsClearMessage(msg))
+    auto it = std::lower_bound(m_logLines.begin(), m_logLines.end(), line, [](const LogLine& logLine, int line) { return logLine.line < line; });
+    if (it == m_logLines.end() || it->line != line)
     {
-        Clear();
+        return -1;
     }
+    return static_cast<int>(it - m_logLines.begin());
+}
 
-    if (!IsIncluded(msg))
+// forget the lines the logfile dropped because of its history size,
+// m_logLines is sorted so only the front needs to be checked.
+void CLogView::TrimLines(int beginIndex)
+{
+    if (m_logLines.empty() || m_logLines.front().line >= beginIndex)
     {
         return;
     }
 
-    if (IsBeepMessage(msg))
+    auto it = std::lower_bound(m_logLines.begin(), m_logLines.end(), beginIndex, [](const LogLine& logLine, int line) { return logLine.line < line; });
+    m_trimmedLines += static_cast<int>(it - m_logLines.begin());
+    m_logLines.erase(m_logLines.begin(), it);
+    m_dirty = true;
+}
+
+// runs on a FilterStage worker while the UI thread waits in CMainFrame::AddMessages()
+void CLogView::EvaluateFilters(const std::vector<MessageRef>& messages, size_t begin, size_t end, int firstLine, std::vector<FilterMatch>& matches)
+{
+    // the scan of ApplyFilters() reaches these lines as well
+    if (m_rescan)
     {
-        MessageBeep(0xFFFFFFFF); // A simple beep. If the sound card is not available, the sound is generated using the speaker.
+        matches.clear();
+        return;
     }
 
-    m_dirty = true;
-    m_changed = true;
-    auto it = m_logLines.begin();
-    while (it != m_logLines.end() && it->line < beginIndex)
+    FilterMessages(m_filter, m_filterProgram, m_matchColors, messages, begin, end, firstLine, matches);
+}
+
+void CLogView::Add(int beginIndex, const FilterMatch& match)
+{
+    TrimLines(beginIndex);
+
+    // the lines of the batch after this one were evaluated already, they stay
+    if (match.clear)
     {
-        ++it;
+        ClearLines(match.line + 1);
     }
-    m_logLines.erase(m_logLines.begin(), it);
 
-    int viewline = static_cast<int>(m_logLines.size());
+    // the line already left the log when a batch is larger than the log
+    if (!match.included || match.line < beginIndex)
+    {
+        return;
+    }
+
+    m_dirty = true;
+    m_changed = true;
 
-    LogLine logline(line);
-    logline.bookmark = MatchFilterType(FilterType::Bookmark, msg);
+    LogLine logline(match.line);
+    logline.bookmark = match.bookmark;
+    logline.color = static_cast<short>(match.color);
     m_logLines.push_back(logline);
+    ApplyActions(match);
+}
 
-    if (m_autoScrollDown && MatchFilterType(FilterType::Stop, msg))
+// the beep, stop and track actions of a line that was just added
+void CLogView::ApplyActions(const FilterMatch& match)
+{
+    if (match.beep)
     {
-        m_stop = [this, viewline]() {
+        MessageBeep(0xFFFFFFFF); // A simple beep. If the sound card is not available, the sound is generated using the speaker.
+    }
+
+    int line = match.line;
+
+    // item indexes shift when lines are trimmed, so look the item up when the scroll is executed
+    if (m_autoScrollDown && match.stop)
+    {
+        m_stop = [this, line]() {
             StopScrolling();
-            ScrollToIndex(viewline, true);
+            ScrollToIndex(LineToItem(line), true);
         };
         return;
     }
 
-    if (MatchFilterType(FilterType::Track, msg))
+    if (match.track)
     {
         m_autoScrollDown = false;
-        m_track = [this, viewline]() {
-            return ScrollToIndex(viewline, true);
+        m_track = [this, line]() {
+            return ScrollToIndex(LineToItem(line), true);
         };
     }
 }
@@ -1541,9 +1647,40 @@ void CLogView::BeginUpdate()
 
 bool CLogView::EndUpdate()
 {
+    // the lines are not added while ApplyFilters() scans, but the log can drop the lines it found
+    if (m_rescan)
+    {
+        TrimLines(m_logFile.BeginIndex());
+    }
+
     if (m_dirty)
     {
+        int focusItem = -1;
+        int topItem = 0;
+        if (m_trimmedLines > 0)
+        {
+            // keep the focus and the scroll position on the same lines after the front was trimmed
+            focusItem = GetNextItem(-1, LVNI_FOCUSED);
+            topItem = GetTopIndex();
+            ClearSelection();
+            SetItemState(focusItem, 0, LVIS_FOCUSED);
+        }
+
         SetItemCountEx(static_cast<int>(m_logLines.size()), LVSICF_NOSCROLL);
+
+        if (m_trimmedLines > 0)
+        {
+            if (focusItem >= m_trimmedLines)
+            {
+                SetItemState(focusItem - m_trimmedLines, LVIS_FOCUSED | LVIS_SELECTED, LVIS_FOCUSED | LVIS_SELECTED);
+            }
+            if (!m_autoScrollDown && topItem > 0)
+            {
+                EnsureVisible(std::max(0, topItem - m_trimmedLines), 0);
+            }
+            m_trimmedLines = 0;
+        }
+
         if (m_autoScrollDown)
         {
             ScrollDown();
@@ -1816,7 +1953,10 @@ bool CLogView::Find(std::wstring_view text, int direction)
 {
     StopTracking();
 
-    int line = FindLine([text, this](const LogLine& line) { return Contains(m_logFile[line.line].text, Str(text)); }, direction);
+    std::string str = Str(text);
+    LineQuery query;
+    query.textAnyOf.push_back(str);
+    int line = FindLine([&str, &query, this](const LogLine& line) { return m_logFile.MayMatch(line.line, query) && Contains(m_logFile.GetMessageRef(line.line).text, str); }, direction);
     if (line < 0)
     {
         return false;
@@ -1925,17 +2065,18 @@ void CLogView::LoadSettings(CRegKey& reg)
         m_columns.swap(columns);
     }
 
+    auto filter = m_filter;
     CRegKey regFilters;
     if (regFilters.Open(reg, L"MessageFilters") == ERROR_SUCCESS)
     {
-        LoadFilterSettings(m_filter.messageFilters, regFilters);
+        LoadFilterSettings(filter.messageFilters, regFilters);
     }
     if (regFilters.Open(reg, L"ProcessFilters") == ERROR_SUCCESS)
     {
-        LoadFilterSettings(m_filter.processFilters, regFilters);
+        LoadFilterSettings(filter.processFilters, regFilters);
     }
 
-    ApplyFilters();
+    ApplyFilters(std::move(filter));
     UpdateColumns();
 }
 
@@ -1982,7 +2123,7 @@ void CLogView::SaveSelection(const std::wstring& fileName) const
     while ((item = GetNextItem(item, LVNI_ALL | LVNI_SELECTED)) >= 0)
     {
         int line = m_logLines[item].line;
-        const Message& msg = m_logFile[line];
+        auto msg = m_logFile.GetMessageRef(line);
         WriteLogFileMessage(fs, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
     }
 
@@ -1998,11 +2139,17 @@ void CLogView::Save(const std::wstring& filename) const
     std::ofstream fs;
     OpenLogFile(fs, filename);
 
+    // the view only holds the included lines, prefetch by item rather than by line
+    const int prefetchItems = 4096;
     int lines = GetItemCount();
     for (int i = 0; i < lines; ++i)
     {
+        if (i % prefetchItems == 0 && i + prefetchItems < lines)
+        {
+            m_logFile.Prefetch(m_logLines[i + prefetchItems].line, m_logLines[std::min(i + 2 * prefetchItems, lines) - 1].line);
+        }
         int line = m_logLines[i].line;
-        const Message& msg = m_logFile[line];
+        auto msg = m_logFile.GetMessageRef(line);
         WriteLogFileMessage(fs, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
     }
 
@@ -2021,8 +2168,7 @@ LogFilter CLogView::GetFilters() const
 void CLogView::SetFilters(const LogFilter& filter)
 {
     StopTracking();
-    m_filter = filter;
-    ApplyFilters();
+    ApplyFilters(filter);
 }
 
 std::vector<int> CLogView::GetBookmarks() const
@@ -2059,63 +2205,218 @@ void CLogView::ResetFilters()
 
 void CLogView::ApplyFilters()
 {
-    ResetFilters();
-    ClearSelection();
+    ApplyFilters(m_filter, FilterEdit::Arbitrary);
+}
 
-    int focusItem = GetNextItem(-1, LVIS_FOCUSED);
+void CLogView::ApplyFilters(LogFilter filter)
+{
+    auto edit = ClassifyFilterEdit(m_filter, filter);
+    ApplyFilters(std::move(filter), edit);
+}
+
+// the log is filtered by ScanLines(), first here and then on a timer until all lines are scanned.
+// The lines and filters from before stay in m_rescan for CancelFiltering(), also when the filters change again during the scan.
+// After a narrowing edit only the lines that were included are scanned, after a widening edit only the lines that were not.
+// While a scan runs the included lines are not known, then any edit is filtered in full.
+void CLogView::ApplyFilters(LogFilter filter, FilterEdit::type edit)
+{
+    int focusItem = GetNextItem(-1, LVNI_FOCUSED);
+    ClearSelection();
     SetItemState(focusItem, 0, LVIS_FOCUSED);
-    int focusLine = focusItem < 0 ? -1 : m_logLines[focusItem].line;
 
-    auto bookmarks = GetBookmarks();
-    auto itBookmark = bookmarks.begin();
+    auto previous = std::move(m_rescan);
+    std::swap(m_filter, filter);
+    if (previous)
+    {
+        edit = FilterEdit::Arbitrary;
+    }
+    m_rescan = std::make_unique<FilterRescan>(m_logFile, m_filter, GetFilterQuery(m_filter), std::max(m_firstLine, m_logFile.BeginIndex()), m_mainFrame.GetFilterStage().GetThreadCount() + 1);
+    auto& rescan = *m_rescan;
+    if (previous)
+    {
+        rescan.focusLine = previous->focusLine;
+        rescan.bookmarks = std::move(previous->bookmarks);
+        rescan.previousFilter = std::move(previous->previousFilter);
+        rescan.previousMatchColors = std::move(previous->previousMatchColors);
+        rescan.previousLines = std::move(previous->previousLines);
+        rescan.previousEnd = previous->previousEnd;
+        m_logLines.clear();
+    }
+    else
+    {
+        rescan.focusLine = focusItem < 0 ? -1 : m_logLines[focusItem].line;
+        rescan.bookmarks = GetBookmarks();
+        rescan.previousFilter = std::move(filter);
+        rescan.previousMatchColors = m_matchColors;
+        rescan.previousLines.swap(m_logLines);
+        rescan.previousEnd = m_logFile.EndIndex();
+    }
 
-    std::deque<LogLine> logLines;
-    //    logLines.reserve(m_logLines.size());
-    int count = m_logFile.Count();
-    int line = m_firstLine;
-    int item = 0;
-    focusItem = -1;
-    while (line < count)
+    if (edit == FilterEdit::Narrowing)
     {
-        if (IsIncluded(m_logFile[line]))
+        std::vector<int> lines;
+        for (auto& logLine : rescan.previousLines)
         {
-            logLines.emplace_back(LogLine(line));
-            if (itBookmark != bookmarks.end() && *itBookmark == line)
-            {
-                logLines.back().bookmark = true;
-                ++itBookmark;
-            }
+            lines.push_back(logLine.line);
+        }
+        rescan.scan.SetCandidates(std::move(lines), rescan.previousEnd);
+    }
+    else if (edit == FilterEdit::Widening)
+    {
+        // the lines that could get another color are filtered again
+        std::vector<char> keepsColor; // per color + 1
+        for (int color = -1; color < static_cast<int>(rescan.previousFilter.messageFilters.size() + rescan.previousFilter.processFilters.size()); ++color)
+        {
+            keepsColor.push_back(KeepsColor(rescan.previousFilter, m_filter, color));
+        }
 
-            if (line <= focusLine)
+        std::vector<FilterMatch> matches;
+        for (auto& logLine : rescan.previousLines)
+        {
+            if (!keepsColor[logLine.color + 1])
             {
-                focusItem = item;
+                continue;
             }
 
-            ++item;
+            FilterMatch match = {};
+            match.line = logLine.line;
+            match.included = true;
+            match.color = logLine.color;
+            matches.push_back(match);
         }
-        ++line;
+        rescan.scan.SetIncluded(std::move(matches), rescan.previousEnd);
+    }
+    else
+    {
+        ResetFilters();
+    }
+    m_filterProgram.Update(m_filter);
+    m_trimmedLines = 0;
+    SetItemCountEx(0, LVSICF_NOSCROLL);
+    ScanLines();
+}
+
+// scans for at most about 50ms so the view stays responsive, it shows the lines found so far.
+// The focus is restored as soon as its line is scanned.
+void CLogView::ScanLines()
+{
+    const double budget = 0.05;
+    auto& rescan = *m_rescan;
+    auto& stage = m_mainFrame.GetFilterStage();
+    auto begin = m_scanTimer.Get();
+    bool more = true;
+    while (more && m_scanTimer.Get() - begin < budget)
+    {
+        m_scanMatches.clear();
+        more = rescan.scan.Step(stage, m_filter, m_filterProgram, m_matchColors, m_scanMatches);
+        AppendMatches(m_scanMatches);
     }
 
-    m_logLines.swap(logLines);
-    SetItemCountEx(static_cast<int>(m_logLines.size()), LVSICF_NOSCROLL);
-    ScrollToIndex(focusItem, false);
-    SetItemState(focusItem, LVIS_FOCUSED, LVIS_FOCUSED);
+    m_dirty = true;
     EndUpdate();
+    if (rescan.focusLine >= 0 && (!more || rescan.scan.GetLine() > rescan.focusLine))
+    {
+        auto it = std::upper_bound(m_logLines.begin(), m_logLines.end(), rescan.focusLine, [](int line, const LogLine& logLine) { return line < logLine.line; });
+        int focusItem = static_cast<int>(it - m_logLines.begin()) - 1;
+        if (focusItem >= 0)
+        {
+            ScrollToIndex(focusItem, false);
+            SetItemState(focusItem, LVIS_FOCUSED, LVIS_FOCUSED);
+        }
+        rescan.focusLine = -1;
+    }
+
+    if (more)
+    {
+        SetTimer(2, 10, nullptr);
+        return;
+    }
+
+    KillTimer(2);
+    m_rescan.reset();
 }
 
-bool FilterSupportsColor(FilterType::type value)
+// the lines added since the scan started also clear the view and take their actions here.
+// A Clear line ends what CancelFiltering() can restore.
+void CLogView::AppendMatches(const std::vector<FilterMatch>& matches)
 {
-    switch (value)
+    auto& rescan = *m_rescan;
+    auto& bookmarks = rescan.bookmarks;
+    auto& bookmark = rescan.bookmark;
+    for (auto& match : matches)
     {
-    case FilterType::Include:
-    case FilterType::Highlight:
-    case FilterType::Track:
-    case FilterType::Stop:
-    case FilterType::Once:
-        return true;
-    default: break;
+        if (match.clear)
+        {
+            ClearLines(match.line + 1);
+            rescan.previousLines.clear();
+            rescan.previousEnd = match.line + 1;
+        }
+        if (!match.included)
+        {
+            continue;
+        }
+
+        while (bookmark < bookmarks.size() && bookmarks[bookmark] < match.line)
+        {
+            ++bookmark;
+        }
+
+        LogLine logLine(match.line);
+        logLine.bookmark = match.bookmark || (bookmark < bookmarks.size() && bookmarks[bookmark] == match.line);
+        logLine.color = static_cast<short>(match.color);
+        m_logLines.push_back(logLine);
+        ApplyActions(match);
+    }
+}
+
+bool CLogView::IsFiltering() const
+{
+    return m_rescan != nullptr;
+}
+
+int CLogView::GetFilterProgress() const
+{
+    if (!m_rescan)
+    {
+        return -1;
+    }
+
+    auto done = static_cast<long long>(m_rescan->scan.GetLine()) - m_rescan->beginLine;
+    auto total = static_cast<long long>(m_logFile.EndIndex()) - m_rescan->beginLine;
+    return total > 0 ? static_cast<int>(std::clamp(100 * done / total, 0LL, 100LL)) : 100;
+}
+
+// restores the lines and filters from before ApplyFilters(), the lines that were added since are filtered with these
+void CLogView::CancelFiltering()
+{
+    if (!m_rescan)
+    {
+        return;
+    }
+
+    KillTimer(2);
+    ClearSelection();
+    auto& rescan = *m_rescan;
+    m_filter = std::move(rescan.previousFilter);
+    m_matchColors = std::move(rescan.previousMatchColors);
+    m_logLines = std::move(rescan.previousLines);
+    m_filterProgram.Update(m_filter);
+
+    FilterScan scan(m_logFile, m_filter, LineQuery(), rescan.previousEnd, m_mainFrame.GetFilterStage().GetThreadCount() + 1);
+    rescan.bookmarks.clear();
+    bool more = true;
+    while (more)
+    {
+        m_scanMatches.clear();
+        more = scan.Step(m_mainFrame.GetFilterStage(), m_filter, m_filterProgram, m_matchColors, m_scanMatches);
+        AppendMatches(m_scanMatches);
     }
-    return false;
+
+    m_rescan.reset();
+    TrimLines(m_logFile.BeginIndex());
+    m_trimmedLines = 0; // the view shows other lines until EndUpdate(), there is no focus to keep
+    m_dirty = true;
+    EndUpdate();
 }
 
 std::vector<Filter> MoveHighlighFiltersToFront(std::vector<Filter> filters)
@@ -2124,13 +2425,13 @@ std::vector<Filter> MoveHighlighFiltersToFront(std::vector<Filter> filters)
     return filters;
 }
 
-TextColor CLogView::GetTextColor(const Message& msg) const
+TextColor CLogView::GetTextColor(const MessageRef& msg) const
 {
     auto messageFilters = MoveHighlighFiltersToFront(m_filter.messageFilters);
     for (auto& filter : messageFilters)
     {
-        std::smatch match;
-        if (filter.enable && FilterSupportsColor(filter.filterType) && std::regex_search(msg.text, match, filter.re))
+        std::cmatch match;
+        if (filter.enable && FilterSupportsColor(filter.filterType) && filter.required.IsIn(msg.text) && std::regex_search(msg.text.data(), msg.text.data() + msg.text.size(), match, filter.re))
         {
             if (filter.bgColor == Colors::Auto)
             {
@@ -2150,7 +2451,7 @@ TextColor CLogView::GetTextColor(const Message& msg) const
     auto processFilters = MoveHighlighFiltersToFront(m_filter.processFilters);
     for (auto& filter : processFilters)
     {
-        if (filter.enable && FilterSupportsColor(filter.filterType) && std::regex_search(msg.processName, filter.re))
+        if (filter.enable && FilterSupportsColor(filter.filterType) && IsMatch(filter, msg.processName))
         {
             return TextColor(filter.bgColor, filter.fgColor);
         }
@@ -2159,29 +2460,43 @@ TextColor CLogView::GetTextColor(const Message& msg) const
     return TextColor(m_processColors ? msg.color : Colors::BackGround, Colors::Text);
 }
 
-bool CLogView::IsClearMessage(const Message& msg) const
+// color is the filter that FilterProgram found when the line was added, a fixed color needs no search.
+// StopScrolling() disables the Track filters without refiltering, the line then searches all filters again.
+TextColor CLogView::GetTextColor(const MessageRef& msg, int color) const
 {
-    using debugviewpp::MatchFilterType;
-    return MatchFilterType(m_filter.messageFilters, FilterType::Clear, msg.text);
-}
+    if (color < 0)
+    {
+        return TextColor(m_processColors ? msg.color : Colors::BackGround, Colors::Text);
+    }
 
-bool CLogView::IsBeepMessage(const Message& msg) const
-{
-    using debugviewpp::MatchFilterType;
-    return MatchFilterType(m_filter.messageFilters, FilterType::Beep, msg.text) || MatchFilterType(m_filter.processFilters, FilterType::Beep, msg.text);
-}
+    auto messageFilters = static_cast<int>(m_filter.messageFilters.size());
+    if (color >= messageFilters + static_cast<int>(m_filter.processFilters.size()))
+    {
+        return GetTextColor(msg);
+    }
 
-bool CLogView::IsIncluded(const Message& msg)
-{
-    using debugviewpp::IsIncluded;
-    return IsIncluded(m_filter.processFilters, msg.processName, m_matchColors) && IsIncluded(m_filter.messageFilters, msg.text, m_matchColors);
-}
+    auto& filter = color < messageFilters ? m_filter.messageFilters[color] : m_filter.processFilters[color - messageFilters];
+    if (!filter.enable)
+    {
+        return GetTextColor(msg);
+    }
 
-bool CLogView::MatchFilterType(FilterType::type type, const Message& msg) const
-{
-    using debugviewpp::MatchFilterType;
-    return MatchFilterType(m_filter.messageFilters, type, msg.text) ||
-           MatchFilterType(m_filter.processFilters, type, msg.processName);
+    // an auto color is looked up by the matched token, only for the message filters
+    if (filter.bgColor != Colors::Auto || color >= messageFilters)
+    {
+        return TextColor(filter.bgColor, filter.fgColor);
+    }
+
+    std::cmatch match;
+    if (std::regex_search(msg.text.data(), msg.text.data() + msg.text.size(), match, filter.re))
+    {
+        auto it = m_matchColors.find(MatchKey(match, filter.matchType));
+        if (it != m_matchColors.end())
+        {
+            return TextColor(it->second, Colors::Text);
+        }
+    }
+    return GetTextColor(msg);
 }
 
 } // namespace debugviewpp
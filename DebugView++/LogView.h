@@ -9,12 +9,16 @@
 
 #include <vector>
 #include <deque>
+#include <memory>
 #include <boost/property_tree/ptree_fwd.hpp>
 #include "Win32/Window.h"
 #include "Win32/Win32Lib.h"
 #include "CobaltFusion/AtlWinExt.h"
 #include "CobaltFusion/stringbuilder.h"
+#include "CobaltFusion/Timer.h"
 #include "DebugView++Lib/LogFile.h"
+#include "DebugView++Lib/FilterStage.h"
+#include "DebugView++Lib/FilterScan.h"
 #include "FilterDlg.h"
 #include "DropTargetSupport.h"
 #include "Win32/Com.h"
@@ -57,6 +61,7 @@ struct LogLine
     explicit LogLine(int line);
 
     bool bookmark;
+    short color; // FilterResult::color, -1 is the default color
     int line;
 };
 
@@ -139,6 +144,22 @@ public:
     }
 };
 
+// the state of CLogView::ApplyFilters() while it scans the log on a timer.
+// The lines and filters from before are kept until the scan is done, CancelFiltering() restores them.
+struct FilterRescan
+{
+    FilterRescan(const LogFile& logFile, const LogFilter& filter, LineQuery query, int beginLine, size_t chunks);
+
+    FilterScan scan;
+    int beginLine;
+    int focusLine; // -1 when there is no focus, set to -1 when the focus is restored
+    std::vector<int> bookmarks;
+    size_t bookmark; // the first bookmark that is not passed yet
+    LogFilter previousFilter;
+    MatchColors previousMatchColors;
+    std::deque<LogLine> previousLines;
+    int previousEnd; // the lines from here on were not filtered with the previous filters
+};
 
 class CLogView : public CDoubleBufferWindowImpl<CLogView, CListViewCtrl,
                      CWinTraitsOR<
@@ -166,7 +187,8 @@ public:
     void Clear();
     int GetFocusLine() const;
     void SetFocusLine(int line);
-    void Add(int beginIndex, int line, const Message& msg);
+    void EvaluateFilters(const std::vector<MessageRef>& messages, size_t begin, size_t end, int firstLine, std::vector<FilterMatch>& matches);
+    void Add(int beginIndex, const FilterMatch& match);
     void BeginUpdate();
     bool EndUpdate();
     void ClearSelection();
@@ -191,6 +213,9 @@ public:
 
     LogFilter GetFilters() const;
     void SetFilters(const LogFilter& filter);
+    bool IsFiltering() const;
+    int GetFilterProgress() const; // percentage of the lines ApplyFilters() scanned, -1 when it is done
+    void CancelFiltering();
 
     using CListViewCtrl::GetItemText;
     std::wstring GetLineAsText(int item) const;
@@ -294,15 +319,20 @@ private:
 
     template <typename Predicate>
     int FindLine(Predicate pred, int direction) const;
+    int LineToItem(int line) const;
+    void TrimLines(int beginIndex);
 
     bool Find(std::wstring_view text, int direction);
     bool FindProcess(int direction);
     void ApplyFilters();
-    bool IsClearMessage(const Message& msg) const;
-    bool IsBeepMessage(const Message& msg) const;
-    bool IsIncluded(const Message& msg);
-    bool MatchFilterType(FilterType::type type, const Message& msg) const;
-    TextColor GetTextColor(const Message& msg) const;
+    void ApplyFilters(LogFilter filter);
+    void ApplyFilters(LogFilter filter, FilterEdit::type edit);
+    void ScanLines();
+    void AppendMatches(const std::vector<FilterMatch>& matches);
+    void ApplyActions(const FilterMatch& match);
+    void ClearLines(int firstLine);
+    TextColor GetTextColor(const MessageRef& msg) const;
+    TextColor GetTextColor(const MessageRef& msg, int color) const;
     void ResetFilters();
 
     std::wstring m_name;
@@ -310,10 +340,15 @@ private:
     LogFile& m_logFile;
     LogFilter m_filter;
     MatchColors m_matchColors;
+    FilterProgram m_filterProgram;
+    std::unique_ptr<FilterRescan> m_rescan;
+    std::vector<FilterMatch> m_scanMatches;
+    Timer m_scanTimer;
     CMyHeaderCtrl m_hdr;
     std::vector<ColumnInfo> m_columns;
     int m_firstLine;
     std::deque<LogLine> m_logLines;
+    int m_trimmedLines;
     bool m_clockTime;
     bool m_processColors;
     bool m_autoScrollDown;
@@ -383,14 +383,45 @@ SelectionInfo CMainFrame::GetLogFileRange() const
         return SelectionInfo();
     }
 
-    return SelectionInfo(0, m_logFile.Count() - 1, m_logFile.Count());
+    return SelectionInfo(m_logFile.BeginIndex(), m_logFile.EndIndex() - 1, m_logFile.Count());
+}
+
+// the DBWIN capture ring fills up when the lines are not taken fast enough, OutputDebugString callers then wait
+std::wstring CMainFrame::GetCaptureStatusText() const
+{
+    size_t ringFullCount = 0;
+    double stallTime = 0.0;
+    for (auto pReader : {m_pLocalReader, m_pGlobalReader})
+    {
+        if (pReader != nullptr)
+        {
+            ringFullCount += pReader->GetRingFullCount();
+            stallTime += pReader->GetStallTime();
+        }
+    }
+
+    wstringbuilder text;
+    text << (m_pLocalReader != nullptr ? L"Ready" : L"Paused");
+    if (ringFullCount > 0)
+    {
+        text << L", capture ring full " << ringFullCount << L"x, callers stalled " << FormatDuration(stallTime);
+    }
+    auto droppedLines = m_logSources.GetDroppedLines();
+    if (droppedLines > 0)
+    {
+        text << L", " << droppedLines << L" lines dropped";
+    }
+    return text;
 }
 
 void CMainFrame::UpdateStatusBar()
 {
     auto isearch = GetView().GetHighlightText();
     std::wstring search = wstringbuilder() << L"Searching: \"" << isearch << L"\"";
-    UISetText(ID_DEFAULT_PANE, isearch.empty() ? (m_pLocalReader != nullptr ? L"Ready" : L"Paused") : search.c_str());
+    auto progress = GetView().GetFilterProgress();
+    std::wstring filtering = wstringbuilder() << L"Filtering: " << progress << L"%, press Esc to cancel";
+    auto capture = GetCaptureStatusText();
+    UISetText(ID_DEFAULT_PANE, progress >= 0 ? filtering.c_str() : isearch.empty() ? capture.c_str() : search.c_str());
     UISetText(ID_SELECTION_PANE, GetSelectionInfoText(L"Selected", GetView().GetSelectedRange()).c_str());
     UISetText(ID_VIEW_PANE, GetSelectionInfoText(L"View", GetView().GetViewRange()).c_str());
     UISetText(ID_LOGFILE_PANE, GetSelectionInfoText(L"Log", GetLogFileRange()).c_str());
@@ -400,36 +431,37 @@ void CMainFrame::UpdateStatusBar()
     UISetText(ID_MEMORY_PANE, FormatBytes(memoryUsage).c_str());
 }
 
-void CMainFrame::ProcessLines(const Lines& lines)
+void CMainFrame::ProcessLines(const LineBatch& lines, size_t begin, size_t end)
 {
-    if (lines.empty())
+    if (begin == end)
     {
         return;
     }
 
-    // design decision: filtering is done on the UI thread, see CLogView::Add
-    // changing this would introduces extra thread and thus complexity. Do that only if it solves a problem.
-
     int views = GetViewCount();
     for (int i = 0; i < views; ++i)
     {
         GetView(i).BeginUpdate();
     }
 
-    if (m_logSources.GetProcessPrefix())
-    {
-        for (auto& line : lines)
-        {
-            AddMessage(Message(line.time, line.systemTime, line.pid, line.processName, "[" + std::to_string(line.pid) + "] " + line.message));
-        }
-    }
-    else
+    // the prefixed texts are sized before the messages refer to them
+    bool prefix = m_logSources.GetProcessPrefix();
+    m_prefixedTexts.resize(prefix ? end - begin : 0);
+    m_messages.clear();
+    for (size_t i = begin; i < end; ++i)
     {
-        for (auto& line : lines)
+        auto line = lines[i];
+        std::string_view text = line.message;
+        if (prefix)
         {
-            AddMessage(Message(line.time, line.systemTime, line.pid, line.processName, line.message));
+            auto& prefixed = m_prefixedTexts[i - begin];
+            prefixed.assign("[").append(std::to_string(line.pid)).append("] ").append(line.message);
+            text = prefixed;
         }
+        m_messages.emplace_back(line.time, line.systemTime, line.pid, line.processName, text);
+        m_messages.back().processStartTime = line.processStartTime;
     }
+    AddMessages(m_messages);
 
     for (int i = 0; i < views; ++i)
     {
@@ -442,43 +474,69 @@ void CMainFrame::ProcessLines(const Lines& lines)
     }
 }
 
+// new lines are appended to m_incomingLines, which is reused for every update, and added to the views in
+// batches until the frame budget is used, whatever the number of views and filters.
+// While the views fall behind, lines wait in the line buffer where the ingest budget applies
 bool CMainFrame::OnUpdate()
 {
-    Lines bucket;
-    auto lines = m_logSources.GetLines();
-    int count = 0;
-    for (auto&& line : lines)
+    // the queued update takes these lines, a second chain of updates would spend a second frame budget
+    if (m_updateScheduled)
     {
-        if (count++ < 5000)
-        {
-            bucket.emplace_back(std::move(line));
-        }
-        else
-        {
-            count = 0;
-            m_incomingMessages.emplace_back(std::move(bucket));
-            bucket = Lines();
-        }
+        return true;
     }
-    if (!bucket.empty())
+
+    const size_t maxIncomingLines = 50000;
+    if (m_incomingLines.Count() - m_incomingIndex < maxIncomingLines)
     {
-        m_incomingMessages.emplace_back(std::move(bucket));
+        m_logSources.GetLines(m_incomingLines);
     }
-
-    if (m_incomingMessages.empty())
+    if (m_incomingIndex == m_incomingLines.Count())
     {
         return false;
     }
 
+    m_frameBudget.BeginFrame(m_updateTimer.Get());
+    for (;;)
+    {
+        auto begin = m_updateTimer.Get();
+        auto count = m_frameBudget.NextBatch(begin);
+        if (count == 0)
+        {
+            break;
+        }
+
+        auto end = std::min(m_incomingIndex + count, m_incomingLines.Count());
+        ProcessLines(m_incomingLines, m_incomingIndex, end);
+        m_frameBudget.EndBatch(end - m_incomingIndex, m_updateTimer.Get() - begin);
+        m_incomingIndex = end;
 
-    auto linesbucket = std::move(m_incomingMessages.front());
-    m_incomingMessages.pop_front();
-    ProcessLines(linesbucket);
-    if (!m_incomingMessages.empty())
+        // drained within the budget, take what came in meanwhile
+        if (m_incomingIndex == m_incomingLines.Count())
+        {
+            m_incomingLines.Clear();
+            m_incomingIndex = 0;
+            m_logSources.GetLines(m_incomingLines);
+            if (m_incomingLines.Empty())
+            {
+                return true;
+            }
+        }
+    }
+
+    // while lines keep coming in the batch never runs empty, drop the processed half
+    if (2 * m_incomingIndex >= m_incomingLines.Count())
     {
-        m_GuiExecutorClient->CallAfter(20ms, [this] { OnUpdate(); });
+        m_incomingLines.EraseFront(m_incomingIndex);
+        m_incomingIndex = 0;
     }
 
+    // the next batch follows 1 ms later, the GUI executor runs it from its timer message or, when it is
+    // already due, straight from the posted message that queued it
+    m_updateScheduled = true;
+    m_GuiExecutorClient->CallAfter(1ms, [this] {
+        m_updateScheduled = false;
+        OnUpdate();
+    });
     return true;
 }
 
@@ -697,6 +755,13 @@ bool CMainFrame::LoadSettings()
     SetTitle();
 
     m_hide = Win32::RegGetDWORDValue(reg, L"Hide", 0) != 0;
+    m_logFile.SetMemoryBudget(Win32::RegGetDWORDValue(reg, L"MemoryBudgetMB", 0) * size_t(1024 * 1024));
+
+    IngestBudget budget;
+    budget.maxLines = Win32::RegGetDWORDValue(reg, L"IngestMaxLines", static_cast<DWORD>(budget.maxLines));
+    budget.maxBytes = Win32::RegGetDWORDValue(reg, L"IngestBudgetMB", static_cast<DWORD>(budget.maxBytes / (1024 * 1024))) * size_t(1024 * 1024);
+    budget.policy = static_cast<IngestPolicy>(std::min<DWORD>(Win32::RegGetDWORDValue(reg, L"IngestPolicy", static_cast<DWORD>(budget.policy)), static_cast<DWORD>(IngestPolicy::DropNewest)));
+    m_logSources.SetIngestBudget(budget);
 
     auto fontName = Win32::RegGetStringValue(reg, L"FontName", L"").substr(0, LF_FACESIZE - 1);
     int fontSize = Win32::RegGetDWORDValue(reg, L"FontSize", 8);
@@ -767,6 +832,11 @@ void CMainFrame::SaveSettings()
     reg.SetDWORDValue(L"AutoNewLine", static_cast<DWORD>(m_logSources.GetAutoNewLine()));
     reg.SetDWORDValue(L"AlwaysOnTop", static_cast<DWORD>(GetAlwaysOnTop()));
     reg.SetDWORDValue(L"Hide", static_cast<DWORD>(m_hide));
+    reg.SetDWORDValue(L"MemoryBudgetMB", static_cast<DWORD>(m_logFile.GetMemoryBudget() / (1024 * 1024)));
+    auto budget = m_logSources.GetIngestBudget();
+    reg.SetDWORDValue(L"IngestMaxLines", static_cast<DWORD>(budget.maxLines));
+    reg.SetDWORDValue(L"IngestBudgetMB", static_cast<DWORD>(budget.maxBytes / (1024 * 1024)));
+    reg.SetDWORDValue(L"IngestPolicy", static_cast<DWORD>(budget.policy));
 
     reg.SetStringValue(L"FontName", m_logfont.lfFaceName);
     reg.SetDWORDValue(L"FontSize", LogFontSizeToPointSize(m_logfont.lfHeight));
@@ -921,10 +991,11 @@ void CMainFrame::SaveLogFile(const std::wstring& filename)
 
     std::ofstream fs;
     OpenLogFile(fs, filename);
-    int count = m_logFile.Count();
-    for (int i = 0; i < count; ++i)
+    int end = m_logFile.EndIndex();
+    for (int i = m_logFile.BeginIndex(); i < end; ++i)
     {
-        auto msg = m_logFile[i];
+        m_logFile.PrefetchAhead(i);
+        auto msg = m_logFile.GetMessageRef(i);
         WriteLogFileMessage(fs, msg.time, msg.systemTime, msg.processId, msg.processName, msg.text);
     }
     fs.close();
@@ -1173,13 +1244,31 @@ void CMainFrame::Load(std::istream& file, const std::string& name, FILETIME file
 
     ClearLog();
 
+    auto addLines = [this](const Lines& lines) {
+        std::vector<MessageRef> messages;
+        messages.reserve(lines.size());
+        for (auto& line : lines)
+        {
+            messages.emplace_back(line.time, line.systemTime, line.pid, line.processName, line.message);
+        }
+        AddMessages(messages);
+    };
+
+    const size_t batchSize = 4096;
+    Lines lines;
     Line line(0.0);
     line.processName = name;
     line.systemTime = fileTime;
     while (ReadLogFileMessage(file, line))
     {
-        AddMessage(Message(line.time, line.systemTime, line.pid, line.processName, line.message));
+        lines.push_back(line);
+        if (lines.size() == batchSize)
+        {
+            addLines(lines);
+            lines.clear();
+        }
     }
+    addLines(lines);
 }
 
 void CMainFrame::CapturePipe(HANDLE hPipe)
@@ -1285,6 +1374,8 @@ void CMainFrame::OnLogCrop(UINT /*uNotifyCode*/, int /*nID*/, CWindow /*wndCtl*/
     }
 
     LogFile temp;
+    temp.SetHistorySize(m_logFile.GetHistorySize());
+    temp.SetMemoryBudget(m_logFile.GetMemoryBudget());
     temp.Append(m_logFile, selection.beginLine, selection.endLine);
     std::swap(temp, m_logFile);
 
@@ -1637,26 +1728,65 @@ CLogView& CMainFrame::GetView()
     return GetView(std::max(0, GetTabCtrl().GetCurSel()));
 }
 
-bool IsClearBufferMessage(const std::string& message)
+bool IsClearBufferMessage(std::string_view message)
 {
     return message.find("DBGVIEWCLEAR") == 0;
 }
 
-void CMainFrame::AddMessage(const Message& message)
+FilterStage& CMainFrame::GetFilterStage()
 {
-    if (IsClearBufferMessage(message.text))
+    return m_filterStage;
+}
+
+void CMainFrame::AddMessages(const std::vector<MessageRef>& messages)
+{
+    size_t begin = 0;
+    for (size_t i = 0; i < messages.size(); ++i)
+    {
+        if (IsClearBufferMessage(messages[i].text))
+        {
+            AddMessages(messages, begin, i);
+            ClearLog();
+            begin = i + 1;
+        }
+    }
+    AddMessages(messages, begin, messages.size());
+}
+
+// the filters of the views are evaluated on the filter stage, one view per job, while this thread waits.
+// The views only apply the matches, in line order.
+void CMainFrame::AddMessages(const std::vector<MessageRef>& messages, size_t begin, size_t end)
+{
+    if (begin == end)
     {
-        ClearLog();
         return;
     }
 
+    // Add() can drop old lines, the views must forget lines before the new BeginIndex()
+    int firstLine = m_logFile.EndIndex();
+    for (size_t i = begin; i < end; ++i)
+    {
+        m_logFile.Add(messages[i]);
+    }
     int beginIndex = m_logFile.BeginIndex();
-    int index = m_logFile.EndIndex();
-    m_logFile.Add(message);
+
     int views = GetViewCount();
+    std::vector<CLogView*> logViews;
+    for (int i = 0; i < views; ++i)
+    {
+        logViews.push_back(&GetView(i));
+    }
+    m_viewMatches.resize(views);
+    m_filterStage.Run(views, [&](size_t i) {
+        logViews[i]->EvaluateFilters(messages, begin, end, firstLine, m_viewMatches[i]);
+    });
+
     for (int i = 0; i < views; ++i)
     {
-        GetView(i).Add(beginIndex, index, message);
+        for (auto& match : m_viewMatches[i])
+        {
+            logViews[i]->Add(beginIndex, match);
+        }
     }
 }
 
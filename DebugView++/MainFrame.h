@@ -33,6 +33,8 @@ using ATL::CString;
 #include "DebugView++Lib/LogSources.h"
 #include "DebugView++Lib/FileWriter.h"
 #include "DebugView++Lib/CTimelineView.h"
+#include "DebugView++Lib/FrameBudget.h"
+#include "DebugView++Lib/FilterStage.h"
 #include "CLogViewTabItem2.h"
 #include "FindDlg.h"
 #include "RunDlg.h"
@@ -95,6 +97,7 @@ public:
     void FindNext(const std::wstring& text);
     void FindPrevious(const std::wstring& text);
     void OnDropped(std::wstring uri);
+    FilterStage& GetFilterStage();
 
 private:
     enum
@@ -116,13 +119,14 @@ private:
     LRESULT OnEndSession(WPARAM wParam, LPARAM lParam);
     bool OnUpdate();
     bool OnMouseWheel(UINT nFlags, short zDelta, CPoint pt);
-    void ProcessLines(const Lines& lines);
+    void ProcessLines(const LineBatch& lines, size_t begin, size_t end);
 
     int LogFontSizeFromPointSize(int fontSize);
     int LogFontSizeToPointSize(int logFontSize);
 
     std::wstring GetSelectionInfoText(const std::wstring& label, const SelectionInfo& selection) const;
     SelectionInfo GetLogFileRange() const;
+    std::wstring GetCaptureStatusText() const;
     void UpdateUI();
     void UpdateStatusBar();
     bool LoadSettings();
@@ -137,7 +141,8 @@ private:
     void AddFilterView();
     void AddFilterView(const std::wstring& name, const LogFilter& filter = LogFilter());
     void AddFilterView(std::shared_ptr<CLogView> logview);
-    void AddMessage(const Message& message);
+    void AddMessages(const std::vector<MessageRef>& messages);
+    void AddMessages(const std::vector<MessageRef>& messages, size_t begin, size_t end);
 
     void SetModifiedMark(int tabindex, bool modified);
     void ClearLog();
@@ -220,7 +225,15 @@ private:
     LogSources m_logSources;
     Win32::JobObject m_jobs;
     Win32::Handle m_httpMonitorHandle;
-    std::deque<Lines> m_incomingMessages;
+    LineBatch m_incomingLines;
+    size_t m_incomingIndex = 0; // lines before it are processed
+    FrameBudget m_frameBudget;
+    bool m_updateScheduled = false; // an OnUpdate() call for the remaining lines is queued
+    Timer m_updateTimer;
+    FilterStage m_filterStage;
+    std::vector<MessageRef> m_messages; // the batch in ProcessLines(), reused for every batch
+    std::vector<std::string> m_prefixedTexts; // message texts with the process prefix
+    std::vector<std::vector<FilterMatch>> m_viewMatches;
 };
 
 } // namespace debugviewpp
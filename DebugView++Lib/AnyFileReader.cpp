@@ -8,6 +8,7 @@
 #include "stdafx.h"
 #include <cassert>
 #include "DebugView++Lib/FileIO.h"
+#include "DebugView++Lib/Conversions.h"
 #include "DebugView++Lib/AnyFileReader.h"
 #include "DebugView++Lib/LineBuffer.h"
 #include "DebugView++Lib/Line.h"
@@ -71,6 +71,11 @@ HANDLE BinaryFileReader::GetHandle() const
     return m_handle.get();
 }
 
+bool BinaryFileReader::AllowsBlocking() const
+{
+    return true;
+}
+
 void BinaryFileReader::Notify()
 {
     ReadUntilEof();
@@ -6,6 +6,7 @@
 
 #include "stdafx.h"
 #include <cstdlib>
+#include <mutex>
 #include "DebugView++Lib/Colors.h"
 #include "CobaltFusion/Math.h"
 
@@ -45,19 +46,24 @@ COLORREF HsvToRgb(double h, double s, double v)
     return 0;
 }
 
+// auto colors are also assigned by the FilterStage workers
 COLORREF GetRandomColor(double s, double v)
 {
     static bool randomize = (std::srand(GetTickCount()), true);
     static const double ratio = (1 + std::sqrt(5.)) / 2 - 1;
     // use golden ratio
     static double h = static_cast<double>(std::rand()) / (RAND_MAX + 1);
+    static std::mutex mutex;
 
+    std::unique_lock<std::mutex> lock(mutex);
     h += ratio;
     if (h >= 1)
     {
         h = h - 1;
     }
-    return HsvToRgb(h, s, v);
+    auto hue = h;
+    lock.unlock();
+    return HsvToRgb(hue, s, v);
 }
 
 COLORREF GetRandomBackColor()
@@ -6,11 +6,13 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <cstring>
 #include "DebugView++Lib/DBWinBuffer.h"
 #include "DebugView++Lib/DBWinReader.h"
 #include "DebugView++Lib/ProcessInfo.h"
 #include "DebugView++Lib/LineBuffer.h"
 #include "CobaltFusion/stringbuilder.h"
+#include "CobaltFusion/Str.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -34,6 +36,8 @@ Win32::Handle CreateDBWinBufferMapping(bool global)
     return hMap;
 }
 
+const size_t captureSlots = 128;
+
 DBWinReader::DBWinReader(Timer& timer, ILineBuffer& linebuffer, bool global) :
     LogSource(timer, SourceType::System, linebuffer),
     m_hBuffer(CreateDBWinBufferMapping(global)),
@@ -41,7 +45,15 @@ DBWinReader::DBWinReader(Timer& timer, ILineBuffer& linebuffer, bool global) :
     m_dbWinBufferReady(Win32::CreateEvent(nullptr, false, true, GetDBWinName(global, L"DBWIN_BUFFER_READY").c_str())),
     m_dbWinDataReady(Win32::CreateEvent(nullptr, false, false, GetDBWinName(global, L"DBWIN_DATA_READY").c_str())),
     m_mappedViewOfFile(m_hBuffer.get(), PAGE_READONLY, 0, 0, sizeof(DbWinBuffer)),
-    m_dbWinBuffer(static_cast<const DbWinBuffer*>(m_mappedViewOfFile.Ptr()))
+    m_dbWinBuffer(static_cast<const DbWinBuffer*>(m_mappedViewOfFile.Ptr())),
+    m_messages(captureSlots),
+    m_writeIndex(0),
+    m_readIndex(0),
+    m_messagesAvailable(Win32::CreateEvent(nullptr, false, false, nullptr)),
+    m_messagesRead(Win32::CreateEvent(nullptr, false, false, nullptr)),
+    m_stopCapture(Win32::CreateEvent(nullptr, true, false, nullptr)),
+    m_stallMicroseconds(0),
+    m_ringFullCount(0)
 {
     SetDescription(global ? L"Global Win32 Messages" : L"Win32 Messages");
 
@@ -57,49 +69,158 @@ DBWinReader::DBWinReader(Timer& timer, ILineBuffer& linebuffer, bool global) :
 
     // TODO(jan): Please test this and choose one
 
+    for (auto& message : m_messages)
+    {
+        message.message.reserve(sizeof(DbWinBuffer::data));
+    }
+
+    m_captureThread = std::thread([this] { Capture(); });
+    ::SetThreadPriority(m_captureThread.native_handle(), THREAD_PRIORITY_HIGHEST);
     Win32::SetEvent(m_dbWinBufferReady);
 }
 
+DBWinReader::~DBWinReader()
+{
+    Abort();
+    m_captureThread.join();
+}
+
+void DBWinReader::Abort()
+{
+    LogSource::Abort();
+    Win32::SetEvent(m_stopCapture);
+}
+
 HANDLE DBWinReader::GetHandle() const
 {
-    return m_dbWinDataReady.get();
+    return m_messagesAvailable.get();
+}
+
+// waiting in Notify() fills the capture ring, then OutputDebugString callers wait for the DBWIN buffer
+bool DBWinReader::AllowsBlocking() const
+{
+    return true;
+}
+
+double DBWinReader::GetStallTime() const
+{
+    return m_stallMicroseconds.load() / 1e6;
+}
+
+size_t DBWinReader::GetRingFullCount() const
+{
+    return m_ringFullCount.load();
+}
+
+// every OutputDebugString caller in the system waits for DBWIN_BUFFER_READY, so this thread only copies
+// the message into a free slot and releases the buffer. Resolving the process is left to Notify().
+void DBWinReader::Capture()
+{
+    HANDLE dataReady[] = {m_dbWinDataReady.get(), m_stopCapture.get()};
+    HANDLE slotFree[] = {m_messagesRead.get(), m_stopCapture.get()};
+    for (;;)
+    {
+        if (::WaitForMultipleObjects(2, dataReady, FALSE, INFINITE) != WAIT_OBJECT_0)
+        {
+            return;
+        }
+
+        auto begin = GetTime();
+        auto writeIndex = m_writeIndex.load(std::memory_order_relaxed);
+        if (writeIndex - m_readIndex.load(std::memory_order_acquire) == m_messages.size())
+        {
+            ++m_ringFullCount;
+            do
+            {
+                if (::WaitForMultipleObjects(2, slotFree, FALSE, INFINITE) != WAIT_OBJECT_0)
+                {
+                    return;
+                }
+            } while (writeIndex - m_readIndex.load(std::memory_order_acquire) == m_messages.size());
+        }
+
+        auto& message = m_messages[writeIndex % m_messages.size()];
+        message.time = begin;
+        message.systemTime = Win32::GetSystemTimeAsFileTime();
+        message.pid = m_dbWinBuffer->processId;
+        message.message.assign(m_dbWinBuffer->data, strnlen(m_dbWinBuffer->data, sizeof(m_dbWinBuffer->data)));
+        ::SetEvent(m_dbWinBufferReady.get());
+
+        m_writeIndex.store(writeIndex + 1, std::memory_order_release);
+        ::SetEvent(m_messagesAvailable.get());
+        m_stallMicroseconds += static_cast<uint64_t>(1e6 * (GetTime() - begin));
+    }
 }
 
-// by forcing Notify() to be not inlined, it will have a better change of being aligned correctly
-// in the instruction cache. __declspec(noinline), however measurements do not show any differences
 void DBWinReader::Notify()
+{
+    auto readIndex = m_readIndex.load(std::memory_order_relaxed);
+    auto writeIndex = m_writeIndex.load(std::memory_order_acquire);
+    for (; readIndex != writeIndex; ++readIndex)
+    {
+        Resolve(m_messages[readIndex % m_messages.size()]);
+        m_readIndex.store(readIndex + 1, std::memory_order_release);
+    }
+    ::SetEvent(m_messagesRead.get());
+}
+
+// the process may have ended since it wrote the message, its lines are then added as <system> lines
+void DBWinReader::Resolve(const DBWinMessage& message)
 {
     static_assert(systemProcessNamesCount == Win32::fixedNumberOfSystemPids, "The size of the systemProcessNames array must be 'fixedNumberOfSystemPids' (5)");
-    if (m_dbWinBuffer->processId < Win32::fixedNumberOfSystemPids)
+    if (message.pid < Win32::fixedNumberOfSystemPids)
     {
-        Add(m_dbWinBuffer->processId, systemProcessNames[m_dbWinBuffer->processId], m_dbWinBuffer->data);
+        Add(message.time, message.systemTime, message.pid, systemProcessNames[message.pid], message.message);
     }
-    else
+    else if (!AddCached(message))
     {
-        HANDLE handle = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, m_dbWinBuffer->processId);
+        HANDLE handle = ::OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION | SYNCHRONIZE, FALSE, message.pid);
 #ifdef OPENPROCESS_DEBUG
         if (!handle)
         {
             Win32::Win32Error error(GetLastError(), "OpenProcess");
-            LogSource::Add(stringbuilder() << error.what() << ", data: " << m_dbWinBuffer->data << " (pid: " << m_dbWinBuffer->processId << ")");
+            LogSource::Add(stringbuilder() << error.what() << ", data: " << message.message << " (pid: " << message.pid << ")");
         }
 #else
-        // performance does not improve significantly (almost immeasurable) without the Add() call, nor without the OpenProcess call.
-        // there might be performance to be gained by:
-        // - making a non-virtual Notice() method
-        // - copying the information from m_dbWinBuffer->data and calling SetEvent(m_dbWinBufferReady.get()); before _any_ other operation.
-        // - check the m_dbWinDataReady is already set again after Add()
         if (handle != nullptr)
         {
-            Add(handle, m_dbWinBuffer->data);
+            CacheProcessName(message.pid, handle);
+            Add(message.time, message.systemTime, handle, message.message);
         }
         else
         {
-            Add(m_dbWinBuffer->processId, "<system>", m_dbWinBuffer->data);
+            Add(message.time, message.systemTime, message.pid, "<system>", message.message);
         }
 #endif
     }
-    ::SetEvent(m_dbWinBufferReady.get());
+}
+
+// the first line of a process carries its handle, LogSources keeps that handle and monitors the process.
+// Later lines only carry the pid and the name cached here until the process ends, this saves the
+// OpenProcess, GetProcessId and GetProcessImageFileName calls per line.
+bool DBWinReader::AddCached(const DBWinMessage& message)
+{
+    std::lock_guard<std::mutex> lock(m_processNamesMutex);
+    auto it = m_processNames.find(message.pid);
+    if (it == m_processNames.end())
+    {
+        return false;
+    }
+    Add(message.time, message.systemTime, message.pid, it->second, message.message);
+    return true;
+}
+
+void DBWinReader::CacheProcessName(DWORD pid, HANDLE handle)
+{
+    auto name = Str(ProcessInfo::GetProcessName(handle)).str();
+    std::lock_guard<std::mutex> lock(m_processNamesMutex);
+    m_processNames[pid] = std::move(name);
+}
+
+void DBWinReader::OnProcessEnded(DWORD pid)
+{
+    std::lock_guard<std::mutex> lock(m_processNamesMutex);
+    m_processNames.erase(pid);
 }
 
 } // namespace debugviewpp
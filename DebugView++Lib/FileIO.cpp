@@ -348,9 +348,9 @@ std::string GetOffsetText(double time) // todo: use libfmt ? consider speed here
     return buf;
 }
 
-void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, const std::string& processName, std::string message)
+void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, std::string_view processName, std::string_view message)
 {
-    boost::trim_right_if(message, boost::is_any_of(" \r\n\t"));
+    message = message.substr(0, message.find_last_not_of(" \r\n\t") + 1);
     ofstream << GetOffsetText(time) << "\t" << GetDateTimeText(filetime) << "\t" << pid << "\t" << processName << "\t" << message << "\n";
 }
 
@@ -102,6 +102,12 @@ HANDLE FileReader::GetHandle() const
     return INVALID_HANDLE_VALUE; // m_handle.get();
 }
 
+// the file is read on its own thread, which can wait for the consumer
+bool FileReader::AllowsBlocking() const
+{
+    return true;
+}
+
 void FileReader::Notify()
 {
     //assert(m_handle);
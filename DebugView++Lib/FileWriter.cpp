@@ -6,6 +6,7 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <algorithm>
 #include "DebugView++Lib/LogFile.h"
 #include "DebugView++Lib/FileIO.h"
 #include "DebugView++Lib/FileWriter.h"
@@ -26,7 +27,9 @@ void FileWriter::Run()
     int writeIndex = 0;
     for (;;)
     {
-        while (writeIndex < m_logfile.Count())
+        // lines dropped by the history size before they were written are lost
+        writeIndex = std::max(writeIndex, m_logfile.BeginIndex());
+        while (writeIndex < m_logfile.EndIndex())
         {
             auto msg = m_logfile[writeIndex];
             ++writeIndex;
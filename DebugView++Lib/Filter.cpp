@@ -6,6 +6,8 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <algorithm>
+#include <cassert>
 #include <boost/algorithm/string/case_conv.hpp>
 #include "Win32/Registry.h"
 #include "CobaltFusion/stringbuilder.h"
@@ -15,7 +17,7 @@
 namespace fusion {
 namespace debugviewpp {
 
-std::string MatchKey(const std::smatch& match, MatchType::type matchType)
+std::string MatchKey(const std::cmatch& match, MatchType::type matchType)
 {
     if (matchType == MatchType::RegexGroups && match.size() > 1)
     {
@@ -56,6 +58,7 @@ std::regex_constants::syntax_option_type MakeSot(MatchType::type matchType)
 Filter::Filter(const std::string& text, MatchType::type matchType, FilterType::type filterType, COLORREF bgColor, COLORREF fgColor, bool enable, bool matched) :
     text(text),
     re(MakePattern(matchType, text), MakeSot(matchType)),
+    required(GetRequiredLiteral(MakePattern(matchType, text)), matchType != MatchType::RegexCase),
     matchType(matchType),
     filterType(filterType),
     bgColor(bgColor),
@@ -114,34 +117,107 @@ void LoadFilterSettings(std::vector<Filter>& filters, CRegKey& reg)
     }
 }
 
-bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColors& matchColors)
+void SimpleFilters::Update(const std::vector<Filter>& filters)
 {
-    for (auto& filter : filters)
+    bool changed = filters.size() != m_texts.size();
+    for (size_t i = 0; i < filters.size() && !changed; ++i)
     {
-        if (!filter.enable)
+        bool simple = filters[i].enable && filters[i].matchType == MatchType::Simple;
+        changed = simple != m_simple[i] || (simple && filters[i].text != m_texts[i]);
+    }
+    if (!changed)
+    {
+        return;
+    }
+
+    m_texts.clear();
+    m_simple.clear();
+    m_filterIndexes.clear();
+    std::vector<std::string> patterns;
+    for (size_t i = 0; i < filters.size(); ++i)
+    {
+        bool simple = filters[i].enable && filters[i].matchType == MatchType::Simple;
+        m_texts.push_back(simple ? filters[i].text : std::string());
+        m_simple.push_back(simple);
+        if (simple)
         {
-            continue;
+            patterns.push_back(filters[i].text);
+            m_filterIndexes.push_back(i);
         }
+    }
+    m_matcher = LiteralMatcher(patterns);
+}
+
+void SimpleFilters::Find(std::string_view text, std::vector<char>& hits) const
+{
+    hits.assign(m_texts.size(), 0);
+    if (m_matcher.Empty())
+    {
+        return;
+    }
+
+    thread_local std::vector<char> found;
+    m_matcher.Find(text, found);
+    for (size_t id = 0; id < found.size(); ++id)
+    {
+        hits[m_filterIndexes[id]] = found[id];
+    }
+}
+
+FilterText::FilterText(std::string_view text, const std::vector<char>* pHits) :
+    text(text),
+    pHits(pHits)
+{
+}
+
+bool IsMatch(const Filter& filter, std::string_view text)
+{
+    return filter.required.IsIn(text) && std::regex_search(text.data(), text.data() + text.size(), filter.re);
+}
+
+// a Simple filter is looked up in the hits, only the other filters run their std::regex
+bool IsMatch(const std::vector<Filter>& filters, size_t i, const FilterText& text)
+{
+    if (text.pHits && filters[i].matchType == MatchType::Simple)
+    {
+        assert(text.pHits->size() == filters.size());
+        return (*text.pHits)[i] != 0;
+    }
+    return IsMatch(filters[i], text.text);
+}
 
-        if (filter.filterType == FilterType::Exclude && std::regex_search(text, filter.re))
+bool IsIncluded(std::vector<Filter>& filters, std::string_view text, MatchColors& matchColors)
+{
+    return IsIncluded(filters, FilterText(text), matchColors);
+}
+
+bool IsIncluded(std::vector<Filter>& filters, const FilterText& text, MatchColors& matchColors)
+{
+    for (size_t i = 0; i < filters.size(); ++i)
+    {
+        if (filters[i].enable && filters[i].filterType == FilterType::Exclude && IsMatch(filters, i, text))
         {
             return false;
         }
     }
 
+    auto textBegin = text.text.data();
+    auto textEnd = text.text.data() + text.text.size();
     bool included = false;
     bool includeFilterPresent = false;
-    for (auto& filter : filters)
+    for (size_t i = 0; i < filters.size(); ++i)
     {
+        auto& filter = filters[i];
         if (!filter.enable)
         {
             continue;
         }
 
-        if (filter.bgColor == Colors::Auto)
+        // a filter that cannot match has no tokens to color
+        if (filter.bgColor == Colors::Auto && (text.pHits && filter.matchType == MatchType::Simple ? (*text.pHits)[i] != 0 : filter.required.IsIn(text.text)))
         {
-            std::sregex_iterator begin(text.begin(), text.end(), filter.re);
-            std::sregex_iterator end;
+            std::cregex_iterator begin(textBegin, textEnd, filter.re);
+            std::cregex_iterator end;
             for (auto tok = begin; tok != end; ++tok)
             {
                 auto key = MatchKey(*tok, filter.matchType);
@@ -155,10 +231,10 @@ bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColo
         if (filter.filterType == FilterType::Include)
         {
             includeFilterPresent = true;
-            included |= std::regex_search(text, filter.re);
+            included |= IsMatch(filters, i, text);
         }
 
-        if (filter.filterType == FilterType::Once && std::regex_search(text, filter.re))
+        if (filter.filterType == FilterType::Once && IsMatch(filters, i, text))
         {
             included |= !filter.matched;
             filter.matched = true;
@@ -168,11 +244,16 @@ bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColo
     return !includeFilterPresent || included;
 }
 
-bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, const std::string& text)
+bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, std::string_view text)
 {
-    for (auto& filter : filters)
+    return MatchFilterType(filters, type, FilterText(text));
+}
+
+bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, const FilterText& text)
+{
+    for (size_t i = 0; i < filters.size(); ++i)
     {
-        if (filter.enable && filter.filterType == type && std::regex_search(text, filter.re))
+        if (filters[i].enable && filters[i].filterType == type && IsMatch(filters, i, text))
         {
             return true;
         }
@@ -181,5 +262,63 @@ bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type,
     return false;
 }
 
+void ResetMatched(std::vector<Filter>& filters)
+{
+    for (auto& filter : filters)
+    {
+        filter.matched = false;
+    }
+}
+
+bool HasIncludeFilters(const std::vector<Filter>& filters)
+{
+    return std::any_of(filters.begin(), filters.end(), [](const Filter& filter) { return filter.enable && filter.filterType == FilterType::Include; });
+}
+
+bool MayBeIncluded(const std::vector<Filter>& filters, std::string_view text)
+{
+    if (MatchFilterType(filters, FilterType::Exclude, text))
+    {
+        return false;
+    }
+    if (!HasIncludeFilters(filters))
+    {
+        return true;
+    }
+
+    for (auto& filter : filters)
+    {
+        if (filter.enable && (filter.filterType == FilterType::Include || filter.filterType == FilterType::Once) && IsMatch(filter, text))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+std::vector<std::string> GetIncludeTexts(const std::vector<Filter>& filters)
+{
+    std::vector<std::string> texts;
+    if (!HasIncludeFilters(filters))
+    {
+        return texts;
+    }
+
+    for (auto& filter : filters)
+    {
+        if (!filter.enable || (filter.filterType != FilterType::Include && filter.filterType != FilterType::Once))
+        {
+            continue;
+        }
+
+        if (filter.matchType != MatchType::Simple)
+        {
+            return std::vector<std::string>();
+        }
+        texts.push_back(filter.text);
+    }
+    return texts;
+}
+
 } // namespace debugviewpp
 } // namespace fusion
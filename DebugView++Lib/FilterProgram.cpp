@@ -0,0 +1,271 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <utility>
+#include "DebugView++Lib/Colors.h"
+#include "DebugView++Lib/FilterProgram.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+const size_t reorderInterval = 1024; // runs between two reorders
+const double searchCost = 50.0;      // a std::regex_search relative to a required literal check
+
+// the filter types where any match decides, their filters can be tried in any order
+const FilterType::type anyMatchTypes[] = {FilterType::Exclude, FilterType::Include, FilterType::Clear, FilterType::Beep, FilterType::Bookmark, FilterType::Stop, FilterType::Track};
+
+bool FilterProgram::Key::operator==(const Key& key) const
+{
+    return text == key.text && matchType == key.matchType && filterType == key.filterType && enable == key.enable && autoColor == key.autoColor;
+}
+
+FilterProgram::FilterProgram() :
+    m_runs(0)
+{
+}
+
+void FilterProgram::Update(const LogFilter& filter)
+{
+    Update(m_message, filter.messageFilters);
+    if (Update(m_process, filter.processFilters))
+    {
+        Update(m_processText, filter.processFilters);
+    }
+}
+
+// returns true when the field was rebuilt
+bool FilterProgram::Update(Field& field, const std::vector<Filter>& filters)
+{
+    std::vector<Key> keys;
+    for (auto& filter : filters)
+    {
+        keys.push_back(Key{filter.text, filter.matchType, filter.filterType, filter.enable, filter.bgColor == Colors::Auto});
+    }
+    if (keys == field.keys)
+    {
+        return false;
+    }
+
+    field = Field();
+    field.keys = std::move(keys);
+    field.simpleFilters.Update(filters);
+    field.statistics.resize(filters.size());
+    for (size_t i = 0; i < filters.size(); ++i)
+    {
+        auto& filter = filters[i];
+        if (!filter.enable)
+        {
+            continue;
+        }
+
+        field.types[filter.filterType].push_back(i);
+        if (filter.bgColor == Colors::Auto)
+        {
+            field.autoColors.push_back(i);
+        }
+        if (FilterSupportsColor(filter.filterType))
+        {
+            field.colors.push_back(i);
+        }
+    }
+    std::stable_partition(field.colors.begin(), field.colors.end(), [&](size_t i) { return filters[i].filterType == FilterType::Highlight; });
+    return true;
+}
+
+void FilterProgram::Begin(Field& field, std::string_view text)
+{
+    field.simpleFilters.Find(text, field.hits);
+    field.matches.assign(field.keys.size(), -1);
+}
+
+bool FilterProgram::Match(Field& field, const std::vector<Filter>& filters, size_t i, std::string_view text)
+{
+    auto& match = field.matches[i];
+    if (match < 0)
+    {
+        auto& filter = filters[i];
+        auto& statistics = field.statistics[i];
+        ++statistics.evaluations;
+        if (filter.matchType == MatchType::Simple)
+        {
+            match = field.hits[i];
+        }
+        else if (filter.required.IsIn(text))
+        {
+            ++statistics.searches;
+            match = std::regex_search(text.data(), text.data() + text.size(), filter.re) ? 1 : 0;
+        }
+        else
+        {
+            match = 0;
+        }
+        statistics.matches += match;
+    }
+    return match != 0;
+}
+
+bool FilterProgram::MatchAny(Field& field, const std::vector<Filter>& filters, FilterType::type type, std::string_view text)
+{
+    for (auto i : field.types[type])
+    {
+        if (Match(field, filters, i, text))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+// IsIncluded() on the compiled filters. The token scan of an auto color filter also decides whether it matches
+bool FilterProgram::IsIncluded(Field& field, std::vector<Filter>& filters, std::string_view text, MatchColors& matchColors, bool& excluded)
+{
+    if (MatchAny(field, filters, FilterType::Exclude, text))
+    {
+        excluded = true;
+        return false;
+    }
+
+    for (auto i : field.autoColors)
+    {
+        auto& filter = filters[i];
+        if (field.matches[i] == 0 || (filter.matchType == MatchType::Simple ? field.hits[i] == 0 : !filter.required.IsIn(text)))
+        {
+            field.matches[i] = 0;
+            continue;
+        }
+
+        std::cregex_iterator begin(text.data(), text.data() + text.size(), filter.re);
+        std::cregex_iterator end;
+        field.matches[i] = begin != end ? 1 : 0;
+        for (auto tok = begin; tok != end; ++tok)
+        {
+            auto key = MatchKey(*tok, filter.matchType);
+            if (matchColors.find(key) == matchColors.end())
+            {
+                matchColors.emplace(std::make_pair(key, GetRandomBackColor()));
+            }
+        }
+    }
+
+    bool included = MatchAny(field, filters, FilterType::Include, text);
+    for (auto i : field.types[FilterType::Once])
+    {
+        if (Match(field, filters, i, text))
+        {
+            included |= !filters[i].matched;
+            filters[i].matched = true;
+        }
+    }
+    return field.types[FilterType::Include].empty() || included;
+}
+
+int FilterProgram::FindColor(Field& field, const std::vector<Filter>& filters, std::string_view text)
+{
+    for (auto i : field.colors)
+    {
+        if (Match(field, filters, i, text))
+        {
+            return static_cast<int>(i);
+        }
+    }
+    return -1;
+}
+
+// a filter that is found by the LiteralMatcher pass costs nothing, a regex filter costs a literal check plus
+// a search when the literal is found. The filter with the lowest cost per decisive match goes first.
+void FilterProgram::Reorder(Field& field, const std::vector<Filter>& filters)
+{
+    auto rank = [&](size_t i) {
+        auto& statistics = field.statistics[i];
+        double cost = 0.0;
+        if (filters[i].matchType != MatchType::Simple)
+        {
+            cost = 1.0 + searchCost * (statistics.searches + 1.0) / (statistics.evaluations + 2.0);
+        }
+        return cost * (statistics.evaluations + 2.0) / (statistics.matches + 1.0);
+    };
+
+    for (auto type : anyMatchTypes)
+    {
+        auto& order = field.types[type];
+        std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) { return rank(a) < rank(b); });
+    }
+}
+
+FilterResult FilterProgram::Run(LogFilter& filter, std::string_view text, std::string_view processName, MatchColors& matchColors, unsigned wanted)
+{
+    FilterResult result;
+    Begin(m_message, text);
+    Begin(m_process, processName);
+
+    // the view is cleared before this line, so it is filtered as the first line of the view
+    if ((wanted & FilterResult::Clear) && MatchAny(m_message, filter.messageFilters, FilterType::Clear, text))
+    {
+        result.flags |= FilterResult::Clear;
+        ResetMatched(filter.messageFilters);
+        ResetMatched(filter.processFilters);
+        matchColors.clear();
+    }
+
+    bool excluded = false;
+    bool included = IsIncluded(m_process, filter.processFilters, processName, matchColors, excluded) &&
+                    IsIncluded(m_message, filter.messageFilters, text, matchColors, excluded);
+    if (excluded)
+    {
+        result.flags |= FilterResult::Exclude;
+    }
+
+    if (included)
+    {
+        result.flags |= FilterResult::Include;
+        if (wanted & FilterResult::Beep)
+        {
+            bool beep = MatchAny(m_message, filter.messageFilters, FilterType::Beep, text);
+            if (!beep && !m_processText.types[FilterType::Beep].empty())
+            {
+                Begin(m_processText, text);
+                beep = MatchAny(m_processText, filter.processFilters, FilterType::Beep, text);
+            }
+            if (beep)
+            {
+                result.flags |= FilterResult::Beep;
+            }
+        }
+
+        const std::pair<FilterType::type, FilterResult::Flags> types[] = {{FilterType::Bookmark, FilterResult::Bookmark}, {FilterType::Stop, FilterResult::Stop}, {FilterType::Track, FilterResult::Track}};
+        for (auto& type : types)
+        {
+            if ((wanted & type.second) && (MatchAny(m_message, filter.messageFilters, type.first, text) || MatchAny(m_process, filter.processFilters, type.first, processName)))
+            {
+                result.flags |= type.second;
+            }
+        }
+
+        if (wanted & FilterResult::Color)
+        {
+            result.color = FindColor(m_message, filter.messageFilters, text);
+            if (result.color < 0)
+            {
+                auto color = FindColor(m_process, filter.processFilters, processName);
+                result.color = color < 0 ? -1 : static_cast<int>(filter.messageFilters.size()) + color;
+            }
+        }
+    }
+
+    if (++m_runs % reorderInterval == 0)
+    {
+        Reorder(m_message, filter.messageFilters);
+        Reorder(m_process, filter.processFilters);
+        Reorder(m_processText, filter.processFilters);
+    }
+    return result;
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,383 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <tuple>
+#include "DebugView++Lib/Colors.h"
+#include "DebugView++Lib/FilterScan.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+bool HasOnceFilters(const std::vector<Filter>& filters)
+{
+    return std::any_of(filters.begin(), filters.end(), [](const Filter& filter) { return filter.enable && filter.filterType == FilterType::Once; });
+}
+
+void GetMatched(const LogFilter& filter, std::vector<char>& matched)
+{
+    matched.clear();
+    for (auto& f : filter.messageFilters)
+    {
+        matched.push_back(f.matched);
+    }
+    for (auto& f : filter.processFilters)
+    {
+        matched.push_back(f.matched);
+    }
+}
+
+// every filter that is matched in 'matched' is matched in filter
+bool IsMatchedIn(const std::vector<char>& matched, const LogFilter& filter)
+{
+    auto messageFilters = filter.messageFilters.size();
+    for (size_t i = 0; i < matched.size(); ++i)
+    {
+        auto& f = i < messageFilters ? filter.messageFilters[i] : filter.processFilters[i - messageFilters];
+        if (matched[i] && !f.matched)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+// the enabled filters of a type, sorted
+std::vector<std::pair<std::string, MatchType::type>> GetFilterKeys(const std::vector<Filter>& filters, FilterType::type type)
+{
+    std::vector<std::pair<std::string, MatchType::type>> keys;
+    for (auto& filter : filters)
+    {
+        if (filter.enable && filter.filterType == type)
+        {
+            keys.emplace_back(filter.text, filter.matchType);
+        }
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    return keys;
+}
+
+// every text that passes the 'after' filters of a list passes the 'before' filters:
+// no Exclude filter was removed and the Include filters were added or are a subset
+bool IsNarrowing(const std::vector<Filter>& before, const std::vector<Filter>& after)
+{
+    auto excludesBefore = GetFilterKeys(before, FilterType::Exclude);
+    auto excludesAfter = GetFilterKeys(after, FilterType::Exclude);
+    auto includesBefore = GetFilterKeys(before, FilterType::Include);
+    auto includesAfter = GetFilterKeys(after, FilterType::Include);
+    return std::includes(excludesAfter.begin(), excludesAfter.end(), excludesBefore.begin(), excludesBefore.end()) &&
+           (includesBefore.empty() || (!includesAfter.empty() && std::includes(includesBefore.begin(), includesBefore.end(), includesAfter.begin(), includesAfter.end())));
+}
+
+// the filters that decide the color index of an included line and the auto colors, see FilterProgram
+std::vector<std::tuple<size_t, std::string, MatchType::type, FilterType::type, bool>> GetColorKeys(const std::vector<Filter>& filters)
+{
+    std::vector<std::tuple<size_t, std::string, MatchType::type, FilterType::type, bool>> keys;
+    for (size_t i = 0; i < filters.size(); ++i)
+    {
+        auto& filter = filters[i];
+        bool autoColor = filter.bgColor == Colors::Auto;
+        if (filter.enable && (FilterSupportsColor(filter.filterType) || autoColor))
+        {
+            keys.emplace_back(i, filter.text, filter.matchType, filter.filterType, autoColor);
+        }
+    }
+    return keys;
+}
+
+// the color filters of 'after' are those of 'before' plus filters behind them that are tried after them,
+// so a text keeps the color filter it had. An added auto color filter would miss the tokens of the texts that are kept.
+bool IsColorPrefix(const std::vector<Filter>& before, const std::vector<Filter>& after)
+{
+    auto keysBefore = GetColorKeys(before);
+    auto keysAfter = GetColorKeys(after);
+    return keysBefore.size() <= keysAfter.size() && std::equal(keysBefore.begin(), keysBefore.end(), keysAfter.begin()) &&
+           std::all_of(keysAfter.begin() + keysBefore.size(), keysAfter.end(), [](auto& key) { return std::get<3>(key) != FilterType::Highlight && !std::get<4>(key); });
+}
+
+// The Once filters depend on the lines before, so they make any edit arbitrary
+FilterEdit::type ClassifyFilterEdit(const LogFilter& before, const LogFilter& after)
+{
+    if (HasOnceFilters(before.messageFilters) || HasOnceFilters(before.processFilters) || HasOnceFilters(after.messageFilters) || HasOnceFilters(after.processFilters))
+    {
+        return FilterEdit::Arbitrary;
+    }
+
+    if (IsNarrowing(before.messageFilters, after.messageFilters) && IsNarrowing(before.processFilters, after.processFilters))
+    {
+        return FilterEdit::Narrowing;
+    }
+
+    if (IsNarrowing(after.messageFilters, before.messageFilters) && IsNarrowing(after.processFilters, before.processFilters) &&
+        IsColorPrefix(before.messageFilters, after.messageFilters) && IsColorPrefix(before.processFilters, after.processFilters))
+    {
+        return FilterEdit::Widening;
+    }
+    return FilterEdit::Arbitrary;
+}
+
+// A message color is found before the process colors, so it stays when the message color filters only got more.
+// A process color also needs the same message color filters, its index counts from messageFilters.size()
+bool KeepsColor(const LogFilter& before, const LogFilter& after, int color)
+{
+    auto messageFilters = static_cast<int>(before.messageFilters.size());
+    bool sameMessageColors = GetColorKeys(before.messageFilters) == GetColorKeys(after.messageFilters);
+    bool sameProcessColors = GetColorKeys(before.processFilters) == GetColorKeys(after.processFilters);
+    if (sameMessageColors && sameProcessColors && (color < messageFilters || before.messageFilters.size() == after.messageFilters.size()))
+    {
+        return true;
+    }
+    if (color < 0)
+    {
+        return false;
+    }
+    if (color < messageFilters)
+    {
+        return IsColorPrefix(before.messageFilters, after.messageFilters);
+    }
+    return sameMessageColors && before.messageFilters.size() == after.messageFilters.size() && IsColorPrefix(before.processFilters, after.processFilters);
+}
+
+LineQuery GetFilterQuery(const LogFilter& filter)
+{
+    LineQuery query;
+    query.textAnyOf = GetIncludeTexts(filter.messageFilters);
+    if (HasIncludeFilters(filter.processFilters))
+    {
+        query.processFilter = [filters = filter.processFilters](std::string_view processName) { return MayBeIncluded(filters, processName); };
+    }
+    return query;
+}
+
+FilterScan::FilterScan(const LogFile& logFile, const LogFilter& filter, LineQuery query, int beginLine, size_t chunks, size_t chunkLines) :
+    m_logFile(logFile),
+    m_query(std::move(query)),
+    m_candidates{beginLine, beginLine},
+    m_line(beginLine),
+    m_chunkLines(chunkLines),
+    m_once(HasOnceFilters(filter.messageFilters) || HasOnceFilters(filter.processFilters)),
+    m_chunks(std::max<size_t>(chunks, 1)),
+    m_nextLine(0),
+    m_linesEnd(beginLine),
+    m_nextIncluded(0),
+    m_includedEnd(beginLine),
+    m_liveLine(logFile.EndIndex())
+{
+    for (auto& chunk : m_chunks)
+    {
+        chunk.filter = filter;
+    }
+}
+
+int FilterScan::GetLine() const
+{
+    return m_line;
+}
+
+// the lines that were added after the scan started were not filtered yet, all their flags are needed
+unsigned FilterScan::GetWanted(int line) const
+{
+    return line < m_liveLine ? FilterResult::Include | FilterResult::Color : FilterResult::All;
+}
+
+void FilterScan::SetCandidates(std::vector<int> lines, int endLine)
+{
+    m_lines = std::move(lines);
+    m_nextLine = 0;
+    m_linesEnd = endLine;
+}
+
+void FilterScan::SetIncluded(std::vector<FilterMatch> matches, int endLine)
+{
+    m_included = std::move(matches);
+    m_nextIncluded = 0;
+    m_includedEnd = endLine;
+}
+
+bool FilterScan::Step(FilterStage& stage, LogFilter& filter, FilterProgram& program, MatchColors& matchColors, std::vector<FilterMatch>& matches)
+{
+    size_t chunks = 0;
+    while (chunks < m_chunks.size())
+    {
+        ReadChunk(m_chunks[chunks]);
+        if (m_chunks[chunks].count == 0)
+        {
+            break;
+        }
+        ++chunks;
+    }
+
+    if (chunks > 0)
+    {
+        stage.Run(chunks, [this](size_t i) { FilterChunk(m_chunks[i]); });
+    }
+
+    program.Update(filter);
+    for (size_t i = 0; i < chunks; ++i)
+    {
+        auto begin = matches.size();
+        MergeChunk(m_chunks[i], filter, program, matchColors, matches);
+        AddIncluded(m_chunks[i].endLine, matches, begin);
+    }
+    AddIncluded(m_line, matches, matches.size());
+    return m_line < m_logFile.EndIndex();
+}
+
+// lines the LogFile drops meanwhile are skipped
+void FilterScan::ReadChunk(Chunk& chunk)
+{
+    chunk.count = 0;
+    m_line = std::max(m_line, m_logFile.BeginIndex());
+    int end = m_logFile.EndIndex();
+    while (chunk.count < m_chunkLines && m_line < end)
+    {
+        if (m_line < m_linesEnd)
+        {
+            auto it = std::lower_bound(m_lines.begin() + m_nextLine, m_lines.end(), m_line);
+            m_nextLine = it - m_lines.begin();
+            int next = it == m_lines.end() ? m_linesEnd : std::min(*it, m_linesEnd);
+            if (next != m_line)
+            {
+                m_line = next;
+                continue;
+            }
+        }
+        // blocks of lines that cannot pass the filters are skipped without decoding them,
+        // the lines added after the scan started are all read because they may clear the view
+        else if (m_line < m_liveLine && m_line >= m_candidates.end)
+        {
+            m_candidates = m_logFile.NextCandidates(m_line, m_query);
+            m_line = std::min(m_candidates.begin, m_liveLine);
+            continue;
+        }
+
+        if (m_line < m_includedEnd)
+        {
+            auto it = std::lower_bound(m_included.begin() + m_nextIncluded, m_included.end(), m_line, [](const FilterMatch& match, int line) { return match.line < line; });
+            if (it != m_included.end() && it->line == m_line)
+            {
+                ++m_line;
+                continue;
+            }
+        }
+
+        m_logFile.PrefetchAhead(m_line);
+        auto msg = m_logFile.GetMessageRef(m_line);
+        if (chunk.count == chunk.lines.size())
+        {
+            chunk.lines.emplace_back();
+            chunk.texts.emplace_back();
+            chunk.messages.push_back(msg);
+        }
+        chunk.lines[chunk.count] = m_line;
+        chunk.texts[chunk.count].assign(msg.text);
+        chunk.messages[chunk.count] = msg;
+        ++chunk.count;
+        ++m_line;
+    }
+    chunk.endLine = m_line;
+
+    // the texts do not move anymore
+    for (size_t i = 0; i < chunk.count; ++i)
+    {
+        chunk.messages[i].text = chunk.texts[i];
+    }
+}
+
+// runs on a FilterStage worker
+void FilterScan::FilterChunk(Chunk& chunk) const
+{
+    chunk.matches.clear();
+    chunk.onceMatches.clear();
+    chunk.matchColors.clear();
+    ResetMatched(chunk.filter.messageFilters);
+    ResetMatched(chunk.filter.processFilters);
+    chunk.program.Update(chunk.filter);
+
+    std::vector<char> matched;
+    std::vector<char> nextMatched;
+    GetMatched(chunk.filter, matched);
+    for (size_t i = 0; i < chunk.count; ++i)
+    {
+        auto& msg = chunk.messages[i];
+        auto result = chunk.program.Run(chunk.filter, msg.text, msg.processName, chunk.matchColors, GetWanted(chunk.lines[i]));
+        AddFilterMatch(chunk.lines[i], result, chunk.matches);
+
+        // a Clear line resets the Once filters and auto colors of the view, the merge evaluates it again
+        bool clear = (result.flags & FilterResult::Clear) != 0;
+        if (m_once || clear)
+        {
+            GetMatched(chunk.filter, nextMatched);
+            if (clear || nextMatched != matched)
+            {
+                matched.swap(nextMatched);
+                chunk.onceMatches.push_back(OnceMatch{i, matched});
+            }
+        }
+    }
+}
+
+// A line where no Once filter of the chunk matched first, matches no Once filter that was not matched before,
+// as long as the Once filters matched in the chunk are also matched in filter. Then it is decided as in the chunk.
+// Otherwise the rest of the chunk is evaluated in order.
+void FilterScan::MergeChunk(Chunk& chunk, LogFilter& filter, FilterProgram& program, MatchColors& matchColors, std::vector<FilterMatch>& matches) const
+{
+    MergeOnceMatches(chunk, filter, program, matchColors, matches);
+
+    // the chunk colors are those since its last Clear line, the colors assigned before are kept
+    matchColors.insert(chunk.matchColors.begin(), chunk.matchColors.end());
+}
+
+void FilterScan::MergeOnceMatches(Chunk& chunk, LogFilter& filter, FilterProgram& program, MatchColors& matchColors, std::vector<FilterMatch>& matches) const
+{
+    auto evaluate = [&](size_t i) {
+        auto& msg = chunk.messages[i];
+        auto result = program.Run(filter, msg.text, msg.processName, matchColors, GetWanted(chunk.lines[i]));
+        AddFilterMatch(chunk.lines[i], result, matches);
+    };
+
+    auto it = chunk.matches.begin();
+    for (auto& once : chunk.onceMatches)
+    {
+        int line = chunk.lines[once.index];
+        for (; it != chunk.matches.end() && it->line < line; ++it)
+        {
+            matches.push_back(*it);
+        }
+        if (it != chunk.matches.end() && it->line == line)
+        {
+            ++it;
+        }
+
+        evaluate(once.index);
+        if (!IsMatchedIn(once.matched, filter))
+        {
+            for (size_t i = once.index + 1; i < chunk.count; ++i)
+            {
+                evaluate(i);
+            }
+            return;
+        }
+    }
+    matches.insert(matches.end(), it, chunk.matches.end());
+}
+
+// merges the matches of SetIncluded() before endLine into the matches from begin on
+void FilterScan::AddIncluded(int endLine, std::vector<FilterMatch>& matches, size_t begin)
+{
+    auto middle = matches.size();
+    for (; m_nextIncluded < m_included.size() && m_included[m_nextIncluded].line < endLine; ++m_nextIncluded)
+    {
+        matches.push_back(m_included[m_nextIncluded]);
+    }
+    std::inplace_merge(matches.begin() + begin, matches.begin() + middle, matches.end(), [](const FilterMatch& a, const FilterMatch& b) { return a.line < b.line; });
+}
+
+} // namespace debugviewpp
+} // namespace fusion
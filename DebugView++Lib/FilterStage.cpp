@@ -0,0 +1,174 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include "DebugView++Lib/FilterStage.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+const size_t maxThreads = 7;
+
+// same decisions, in the same order, as CLogView::Add() used to make on the UI thread
+void AddFilterMatch(int line, const FilterResult& result, std::vector<FilterMatch>& matches)
+{
+    if ((result.flags & (FilterResult::Clear | FilterResult::Include)) == 0)
+    {
+        return;
+    }
+
+    FilterMatch match;
+    match.line = line;
+    match.clear = (result.flags & FilterResult::Clear) != 0;
+    match.included = (result.flags & FilterResult::Include) != 0;
+    match.beep = (result.flags & FilterResult::Beep) != 0;
+    match.bookmark = (result.flags & FilterResult::Bookmark) != 0;
+    match.stop = (result.flags & FilterResult::Stop) != 0;
+    match.track = (result.flags & FilterResult::Track) != 0;
+    match.color = result.color;
+    matches.push_back(match);
+}
+
+void FilterMessages(LogFilter& filter, FilterProgram& program, MatchColors& matchColors, const std::vector<MessageRef>& messages, size_t begin, size_t end, int firstLine, std::vector<FilterMatch>& matches)
+{
+    matches.clear();
+    program.Update(filter);
+    for (size_t i = begin; i < end; ++i)
+    {
+        auto& msg = messages[i];
+        auto result = program.Run(filter, msg.text, msg.processName, matchColors);
+        AddFilterMatch(firstLine + static_cast<int>(i - begin), result, matches);
+    }
+}
+
+FilterStage::FilterStage(size_t threads) :
+    m_next(0)
+{
+    for (size_t i = 0; i < threads; ++i)
+    {
+        m_threads.emplace_back([this] { Worker(); });
+    }
+}
+
+FilterStage::~FilterStage()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_end = true;
+    }
+    m_start.notify_all();
+    for (auto& thread : m_threads)
+    {
+        thread.join();
+    }
+}
+
+// the calling thread takes part in every run
+size_t FilterStage::DefaultThreadCount()
+{
+    auto cores = static_cast<size_t>(std::thread::hardware_concurrency());
+    return std::min(cores > 1 ? cores - 1 : 0, maxThreads);
+}
+
+size_t FilterStage::GetThreadCount() const
+{
+    return m_threads.size();
+}
+
+// a single job runs on the calling thread without waking a worker.
+// Workers that have not joined when the calling thread runs out of jobs are not waited for.
+void FilterStage::Run(size_t count, const std::function<void(size_t)>& job)
+{
+    if (count == 1 || m_threads.empty())
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_job = &job;
+        m_count = count;
+        m_next = 0;
+        m_wanted = std::min(m_threads.size(), count - 1);
+        m_joined = 0;
+        m_exception = nullptr;
+    }
+    m_start.notify_all();
+
+    RunJobs();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_wanted = m_joined;
+    m_done.wait(lock, [this] { return m_busy == 0; });
+    m_job = nullptr;
+    auto exception = m_exception;
+    m_exception = nullptr;
+    lock.unlock();
+
+    if (exception)
+    {
+        std::rethrow_exception(exception);
+    }
+}
+
+void FilterStage::Worker()
+{
+    for (;;)
+    {
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_start.wait(lock, [this] { return m_end || m_joined < m_wanted; });
+            if (m_end)
+            {
+                return;
+            }
+            ++m_joined;
+            ++m_busy;
+        }
+
+        RunJobs();
+
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (--m_busy == 0)
+        {
+            m_done.notify_all();
+        }
+    }
+}
+
+void FilterStage::RunJobs()
+{
+    for (;;)
+    {
+        auto i = m_next++;
+        if (i >= m_count)
+        {
+            return;
+        }
+
+        try
+        {
+            (*m_job)(i);
+        }
+        catch (...)
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (!m_exception)
+            {
+                m_exception = std::current_exception();
+            }
+        }
+    }
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -80,5 +80,20 @@ FilterType::type StringToFilterType(const std::string& s)
     throw std::invalid_argument("bad FilterType!");
 }
 
+bool FilterSupportsColor(FilterType::type value)
+{
+    switch (value)
+    {
+    case FilterType::Include:
+    case FilterType::Highlight:
+    case FilterType::Track:
+    case FilterType::Stop:
+    case FilterType::Once:
+        return true;
+    default: break;
+    }
+    return false;
+}
+
 } // namespace debugviewpp
 } // namespace fusion
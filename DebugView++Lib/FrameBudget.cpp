@@ -0,0 +1,72 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include "DebugView++Lib/FrameBudget.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+const double initialLineCost = 2e-6; // until the first batch is measured
+const double smoothing = 0.25;       // weight of the last batch in the line cost
+
+FrameBudget::FrameBudget(double budget, size_t minBatch, size_t maxBatch) :
+    m_budget(budget),
+    m_minBatch(minBatch),
+    m_maxBatch(maxBatch),
+    m_lineCost(initialLineCost),
+    m_frameStart(0.0),
+    m_frameBatches(0),
+    m_lastBatch(0)
+{
+}
+
+void FrameBudget::BeginFrame(double now)
+{
+    m_frameStart = now;
+    m_frameBatches = 0;
+}
+
+// a batch takes at most half of the remaining time and at most twice the lines of the previous batch,
+// so a sudden rise of the line cost, like a new filter, is measured before it can use the whole budget
+size_t FrameBudget::NextBatch(double now) const
+{
+    auto remaining = m_frameStart + m_budget - now;
+    if (m_frameBatches > 0 && remaining < m_minBatch * m_lineCost)
+    {
+        return 0;
+    }
+
+    auto lines = static_cast<size_t>(std::max(remaining, 0.0) / 2 / m_lineCost);
+    lines = std::min(lines, 2 * m_lastBatch);
+    return std::clamp(lines, m_minBatch, m_maxBatch);
+}
+
+void FrameBudget::EndBatch(size_t lines, double seconds)
+{
+    ++m_frameBatches;
+    m_lastBatch = lines;
+    if (lines > 0)
+    {
+        m_lineCost += smoothing * (seconds / lines - m_lineCost);
+        m_lineCost = std::max(m_lineCost, 1e-9);
+    }
+}
+
+double FrameBudget::GetBudget() const
+{
+    return m_budget;
+}
+
+double FrameBudget::GetLineCost() const
+{
+    return m_lineCost;
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -8,6 +8,7 @@
 #include "stdafx.h"
 #include "Win32/Win32Lib.h"
 #include "DebugView++Lib/Line.h"
+#include "DebugView++Lib/LogSource.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -18,7 +19,9 @@ Line::Line(double time, FILETIME systemTime, HANDLE handle, const std::string& m
     handle(handle),
     pid(0),
     message(message),
-    pLogSource(pLogSource)
+    pLogSource(pLogSource),
+    sourceId(pLogSource != nullptr ? pLogSource->GetSourceId() : SourceId()),
+    processStartTime()
 {
 }
 
@@ -29,7 +32,9 @@ Line::Line(double time, FILETIME systemTime, DWORD pid, const std::string& proce
     pid(pid),
     processName(processName),
     message(message),
-    pLogSource(pLogSource)
+    pLogSource(pLogSource),
+    sourceId(pLogSource != nullptr ? pLogSource->GetSourceId() : SourceId()),
+    processStartTime()
 {
 }
 
@@ -0,0 +1,117 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include "DebugView++Lib/LineBatch.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+const size_t noRecord = ~size_t(0);
+
+LineBatch::LineBatch() :
+    m_processNameRecord(noRecord)
+{
+}
+
+bool LineBatch::Empty() const
+{
+    return m_records.empty();
+}
+
+size_t LineBatch::Count() const
+{
+    return m_records.size();
+}
+
+void LineBatch::Clear()
+{
+    m_arena.clear();
+    m_records.clear();
+    m_processNameRecord = noRecord;
+}
+
+void LineBatch::Add(const Line& line, std::string_view message)
+{
+    Add(line.time, line.systemTime, line.pid, line.processName, message, line.pLogSource);
+    m_records.back().processStartTime = line.processStartTime;
+}
+
+// consecutive lines mostly come from the same process, those share the process name in the arena
+void LineBatch::Add(double time, FILETIME systemTime, DWORD pid, std::string_view processName, std::string_view message, const LogSource* pLogSource)
+{
+    Record record;
+    record.time = time;
+    record.systemTime = systemTime;
+    record.pid = pid;
+    record.pLogSource = pLogSource;
+    record.processStartTime = FILETIME();
+    if (m_processNameRecord != noRecord && GetText(m_records[m_processNameRecord].processNameOffset, m_records[m_processNameRecord].processNameSize) == processName)
+    {
+        record.processNameOffset = m_records[m_processNameRecord].processNameOffset;
+    }
+    else
+    {
+        record.processNameOffset = Append(processName);
+        m_processNameRecord = m_records.size();
+    }
+    record.processNameSize = processName.size();
+    record.messageOffset = Append(message);
+    record.messageSize = message.size();
+    m_records.push_back(record);
+}
+
+LineRef LineBatch::operator[](size_t i) const
+{
+    auto& record = m_records[i];
+    return LineRef{record.time, record.systemTime, record.pid, GetText(record.processNameOffset, record.processNameSize), GetText(record.messageOffset, record.messageSize), record.pLogSource, record.processStartTime};
+}
+
+// a shared process name can lie before the first remaining message, so the arena is cut at the lowest offset still in use
+void LineBatch::EraseFront(size_t count)
+{
+    if (count >= m_records.size())
+    {
+        Clear();
+        return;
+    }
+
+    m_records.erase(m_records.begin(), m_records.begin() + count);
+    auto cut = m_arena.size();
+    for (auto& record : m_records)
+    {
+        cut = std::min({cut, record.processNameOffset, record.messageOffset});
+    }
+    m_arena.erase(m_arena.begin(), m_arena.begin() + cut);
+    for (auto& record : m_records)
+    {
+        record.processNameOffset -= cut;
+        record.messageOffset -= cut;
+    }
+    m_processNameRecord = m_processNameRecord < count ? noRecord : m_processNameRecord - count;
+}
+
+size_t LineBatch::GetArenaCapacity() const
+{
+    return m_arena.capacity();
+}
+
+size_t LineBatch::Append(std::string_view text)
+{
+    auto offset = m_arena.size();
+    m_arena.insert(m_arena.end(), text.begin(), text.end());
+    return offset;
+}
+
+std::string_view LineBatch::GetText(size_t offset, size_t size) const
+{
+    return std::string_view(m_arena.data() + offset, size);
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,144 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <cassert>
+#include "CobaltFusion/fusionassert.h"
+#include "DebugView++Lib/LogSource.h"
+#include "DebugView++Lib/ListenerShard.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+ListenerShard::ListenerShard(std::function<void()> onNotify) :
+    m_onNotify(std::move(onNotify)),
+    m_wakeEvent(Win32::CreateEvent(nullptr, false, false, nullptr))
+{
+    m_thread = std::thread([this] { Run(); });
+}
+
+ListenerShard::~ListenerShard()
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_end = true;
+    }
+    Win32::SetEvent(m_wakeEvent);
+    m_thread.join();
+}
+
+size_t ListenerShard::Count() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_members.size();
+}
+
+void ListenerShard::Add(LogSource* pSource)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        assert(m_members.size() < maxSources);
+        m_members.push_back(pSource);
+        ++m_revision;
+    }
+    Win32::SetEvent(m_wakeEvent);
+}
+
+void ListenerShard::Remove(LogSource* pSource)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_members.erase(std::remove(m_members.begin(), m_members.end(), pSource), m_members.end());
+        ++m_revision;
+    }
+    Win32::SetEvent(m_wakeEvent);
+}
+
+void ListenerShard::Synchronize()
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto revision = m_revision;
+    m_applied.wait(lock, [&] { return m_end || m_appliedRevision >= revision; });
+}
+
+// the wake event is the first handle so membership changes go before any source
+void ListenerShard::Run()
+{
+    std::vector<HANDLE> handles;
+    std::vector<LogSource*> sources;
+    try
+    {
+        if (!ApplyChanges(handles, sources))
+        {
+            return;
+        }
+        for (;;)
+        {
+            auto res = Win32::WaitForAnyObject(handles, INFINITE);
+            if (!res.signaled)
+            {
+                continue;
+            }
+
+            auto index = static_cast<size_t>(res.index - WAIT_OBJECT_0);
+            if (index == 0)
+            {
+                if (!ApplyChanges(handles, sources))
+                {
+                    return;
+                }
+                continue;
+            }
+
+            assert(index < sources.size() && "res.index out of range");
+            auto pSource = sources[index];
+            pSource->Notify();
+            if (pSource->AtEnd())
+            {
+                handles.erase(handles.begin() + index);
+                sources.erase(sources.begin() + index);
+            }
+            m_onNotify();
+        }
+    }
+    catch (const std::exception& e)
+    {
+        FUSION_REPORT_EXCEPTION(e.what());
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_end = true;
+        m_applied.notify_all();
+    }
+}
+
+// returns false when the shard is ending
+bool ListenerShard::ApplyChanges(std::vector<HANDLE>& handles, std::vector<LogSource*>& sources)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_end)
+    {
+        m_applied.notify_all();
+        return false;
+    }
+
+    handles.assign(1, m_wakeEvent.get());
+    sources.assign(1, nullptr);
+    for (auto pSource : m_members)
+    {
+        if (!pSource->AtEnd())
+        {
+            handles.push_back(pSource->GetHandle());
+            sources.push_back(pSource);
+        }
+    }
+    m_appliedRevision = m_revision;
+    m_applied.notify_all();
+    return true;
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,262 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <cstring>
+#include <deque>
+#include "DebugView++Lib/LiteralMatcher.h"
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define LITERALSEARCH_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace fusion {
+namespace debugviewpp {
+
+unsigned char FoldCase(unsigned char c)
+{
+    return c >= 'A' && c <= 'Z' ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+unsigned char UpperCase(unsigned char c)
+{
+    return c >= 'a' && c <= 'z' ? static_cast<unsigned char>(c - 'a' + 'A') : c;
+}
+
+LiteralMatcher::LiteralMatcher() :
+    m_count(0),
+    m_classCount(1),
+    m_classes(),
+    m_next(1, 0),
+    m_outputBegin(2, 0)
+{
+}
+
+// the trie is built with 0 as 'no transition', no trie edge leads back to the root.
+// Then a breadth first pass turns it into the complete automaton: a missing transition takes the
+// transition of the failure state and every state inherits the outputs of its failure state.
+LiteralMatcher::LiteralMatcher(const std::vector<std::string>& patterns, bool ignoreCase) :
+    m_count(patterns.size()),
+    m_classCount(1),
+    m_classes()
+{
+    std::array<uint16_t, 256> folded = {};
+    for (auto& pattern : patterns)
+    {
+        for (unsigned char c : pattern)
+        {
+            auto key = ignoreCase ? FoldCase(c) : c;
+            if (folded[key] == 0)
+            {
+                folded[key] = static_cast<uint16_t>(m_classCount++);
+            }
+        }
+    }
+    for (int c = 0; c < 256; ++c)
+    {
+        auto key = static_cast<unsigned char>(c);
+        m_classes[c] = folded[ignoreCase ? FoldCase(key) : key];
+    }
+
+    m_next.assign(m_classCount, 0);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (size_t id = 0; id < patterns.size(); ++id)
+    {
+        if (patterns[id].empty())
+        {
+            m_emptyPatterns.push_back(static_cast<uint32_t>(id));
+            continue;
+        }
+
+        uint32_t state = 0;
+        for (unsigned char c : patterns[id])
+        {
+            auto& next = m_next[state * m_classCount + m_classes[c]];
+            if (next == 0)
+            {
+                next = static_cast<uint32_t>(outputs.size());
+                outputs.emplace_back();
+                m_next.resize(m_next.size() + m_classCount, 0);
+            }
+            state = m_next[state * m_classCount + m_classes[c]];
+        }
+        outputs[state].push_back(static_cast<uint32_t>(id));
+    }
+
+    std::vector<uint32_t> fail(outputs.size(), 0);
+    std::deque<uint32_t> queue;
+    for (size_t c = 0; c < m_classCount; ++c)
+    {
+        if (auto child = m_next[c])
+        {
+            queue.push_back(child);
+        }
+    }
+    while (!queue.empty())
+    {
+        auto state = queue.front();
+        queue.pop_front();
+        for (size_t c = 0; c < m_classCount; ++c)
+        {
+            auto& next = m_next[state * m_classCount + c];
+            auto fallback = m_next[fail[state] * m_classCount + c];
+            if (next == 0)
+            {
+                next = fallback;
+                continue;
+            }
+
+            fail[next] = fallback;
+            auto& inherited = outputs[fallback];
+            outputs[next].insert(outputs[next].end(), inherited.begin(), inherited.end());
+            queue.push_back(next);
+        }
+    }
+
+    m_outputBegin.reserve(outputs.size() + 1);
+    m_outputBegin.push_back(0);
+    for (auto& output : outputs)
+    {
+        m_outputs.insert(m_outputs.end(), output.begin(), output.end());
+        m_outputBegin.push_back(static_cast<uint32_t>(m_outputs.size()));
+    }
+}
+
+bool LiteralMatcher::Empty() const
+{
+    return m_count == 0;
+}
+
+size_t LiteralMatcher::Count() const
+{
+    return m_count;
+}
+
+// stops early once every pattern was found
+void LiteralMatcher::Find(std::string_view text, std::vector<char>& found) const
+{
+    found.assign(m_count, 0);
+    size_t remaining = m_count;
+    for (auto id : m_emptyPatterns)
+    {
+        found[id] = 1;
+        --remaining;
+    }
+
+    uint32_t state = 0;
+    for (unsigned char c : text)
+    {
+        if (remaining == 0)
+        {
+            return;
+        }
+
+        state = m_next[state * m_classCount + m_classes[c]];
+        for (auto i = m_outputBegin[state]; i != m_outputBegin[state + 1]; ++i)
+        {
+            auto id = m_outputs[i];
+            if (!found[id])
+            {
+                found[id] = 1;
+                --remaining;
+            }
+        }
+    }
+}
+
+LiteralSearch::LiteralSearch() :
+    m_ignoreCase(false)
+{
+}
+
+LiteralSearch::LiteralSearch(const std::string& literal, bool ignoreCase) :
+    m_literal(literal),
+    m_ignoreCase(ignoreCase)
+{
+    if (m_ignoreCase)
+    {
+        for (auto& c : m_literal)
+        {
+            c = static_cast<char>(FoldCase(static_cast<unsigned char>(c)));
+        }
+    }
+}
+
+bool LiteralSearch::Empty() const
+{
+    return m_literal.empty();
+}
+
+bool LiteralSearch::Equals(const char* text) const
+{
+    if (!m_ignoreCase)
+    {
+        return std::memcmp(text, m_literal.data(), m_literal.size()) == 0;
+    }
+
+    for (size_t i = 0; i < m_literal.size(); ++i)
+    {
+        if (FoldCase(static_cast<unsigned char>(text[i])) != static_cast<unsigned char>(m_literal[i]))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool LiteralSearch::IsIn(std::string_view text) const
+{
+    auto size = m_literal.size();
+    if (size == 0)
+    {
+        return true;
+    }
+    if (size > text.size())
+    {
+        return false;
+    }
+
+    // candidate positions are [0, end)
+    auto data = text.data();
+    auto end = text.size() - size + 1;
+    size_t i = 0;
+#ifdef LITERALSEARCH_SSE2
+    auto first = static_cast<unsigned char>(m_literal.front());
+    auto last = static_cast<unsigned char>(m_literal.back());
+    auto firstLower = _mm_set1_epi8(static_cast<char>(first));
+    auto firstUpper = _mm_set1_epi8(static_cast<char>(m_ignoreCase ? UpperCase(first) : first));
+    auto lastLower = _mm_set1_epi8(static_cast<char>(last));
+    auto lastUpper = _mm_set1_epi8(static_cast<char>(m_ignoreCase ? UpperCase(last) : last));
+    for (; i + 16 <= end; i += 16)
+    {
+        auto firstChars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto lastChars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i + size - 1));
+        auto firstMatch = _mm_or_si128(_mm_cmpeq_epi8(firstChars, firstLower), _mm_cmpeq_epi8(firstChars, firstUpper));
+        auto lastMatch = _mm_or_si128(_mm_cmpeq_epi8(lastChars, lastLower), _mm_cmpeq_epi8(lastChars, lastUpper));
+        auto mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_and_si128(firstMatch, lastMatch)));
+        for (size_t offset = 0; mask != 0; ++offset, mask >>= 1)
+        {
+            if ((mask & 1) != 0 && Equals(data + i + offset))
+            {
+                return true;
+            }
+        }
+    }
+#endif
+    for (; i < end; ++i)
+    {
+        if (Equals(data + i))
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+} // namespace debugviewpp
+} // namespace fusion
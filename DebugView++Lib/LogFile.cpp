@@ -7,64 +7,407 @@
 
 #include "stdafx.h"
 #include <vector>
-#include "CobaltFusion/Str.h"
+#include <algorithm>
+#include <cstring>
 #include "Win32/Utilities.h"
+#include "IndexedStorageLib/Varint.h"
+#include "DebugView++Lib/Conversions.h"
 #include "DebugView++Lib/LogFile.h"
 
 namespace fusion {
 namespace debugviewpp {
 
+using indexedstorage::GetVarint;
+using indexedstorage::PutVarint;
+using indexedstorage::UnZigZag;
+using indexedstorage::ZigZag;
+
+const int prefetchLines = 4096;
+const int blockLines = 1024;
+const size_t maxBlockProcesses = 32;
+const size_t minCompactProcesses = 4096;
+
 Message::Message(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& msg, COLORREF color) :
     time(time),
     systemTime(systemTime),
     processId(pid),
     processName(processName),
     text(msg),
-    color(color)
+    color(color),
+    processStartTime()
 {
 }
 
+MessageRef::MessageRef(double time, FILETIME systemTime, DWORD pid, std::string_view processName, std::string_view msg, COLORREF color) :
+    time(time),
+    systemTime(systemTime),
+    processId(pid),
+    processName(processName),
+    text(msg),
+    color(color),
+    processStartTime()
+{
+}
+
+MessageRef::MessageRef(const Message& msg) :
+    time(msg.time),
+    systemTime(msg.systemTime),
+    processId(msg.processId),
+    processName(msg.processName),
+    text(msg.text),
+    color(msg.color),
+    processStartTime(msg.processStartTime)
+{
+}
+
+LogFile::MetadataBlock::MetadataBlock(const InternalMessage& msg) :
+    minTime(msg.time),
+    maxTime(msg.time),
+    maxSystemTime(FileTimeToUInt64(msg.systemTime)),
+    anyProcess(false)
+{
+}
+
+uint64_t DoubleToBits(double value)
+{
+    uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    return bits;
+}
+
+double BitsToDouble(uint64_t bits)
+{
+    double value;
+    std::memcpy(&value, &bits, sizeof(value));
+    return value;
+}
+
+// times are stored as deltas of their bit patterns, these are small for ascending times of the same magnitude.
+// System times are stored as deltas, uids as they are.
+template <typename Messages>
+std::string EncodeColumns(const Messages& messages)
+{
+    std::string times;
+    std::string systemTimes;
+    std::string uids;
+    uint64_t lastTime = 0;
+    uint64_t lastSystemTime = 0;
+    for (auto& msg : messages)
+    {
+        auto time = DoubleToBits(msg.time);
+        PutVarint(times, ZigZag(time - lastTime));
+        lastTime = time;
+
+        auto systemTime = FileTimeToUInt64(msg.systemTime);
+        PutVarint(systemTimes, ZigZag(systemTime - lastSystemTime));
+        lastSystemTime = systemTime;
+
+        PutVarint(uids, msg.uid);
+    }
+
+    std::string columns;
+    columns.reserve(times.size() + systemTimes.size() + uids.size() + 6);
+    PutVarint(columns, times.size());
+    columns.append(times);
+    PutVarint(columns, systemTimes.size());
+    columns.append(systemTimes);
+    columns.append(uids);
+    return columns;
+}
+
+template <typename Messages>
+void DecodeColumns(const std::string& columns, size_t count, Messages& messages)
+{
+    const char* p = columns.data();
+    auto timesSize = GetVarint(p);
+    const char* times = p;
+    p += timesSize;
+    auto systemTimesSize = GetVarint(p);
+    const char* systemTimes = p;
+    const char* uids = p + systemTimesSize;
+
+    messages.clear();
+    messages.reserve(count);
+    uint64_t time = 0;
+    uint64_t systemTime = 0;
+    for (size_t i = 0; i < count; ++i)
+    {
+        time += UnZigZag(GetVarint(times));
+        systemTime += UnZigZag(GetVarint(systemTimes));
+        auto uid = static_cast<DWORD>(GetVarint(uids));
+        messages.emplace_back(BitsToDouble(time), MakeFileTime(systemTime), uid);
+    }
+}
+
 bool LogFile::Empty() const
 {
-    return m_messages.empty();
+    return Count() == 0;
 }
 
 void LogFile::Clear()
 {
-    m_messages.clear();
-    m_messages.shrink_to_fit();
+    m_blocks.clear();
+    m_blocks.shrink_to_fit();
+    m_writeMessages.clear();
+    m_writeMessages.shrink_to_fit();
+    m_readMessages.clear();
+    m_readMessages.shrink_to_fit();
+    m_readBlock = -1;
     m_storage.Clear();
     m_storage.shrink_to_fit();
     m_processInfo.Clear();
+    m_beginIndex = 0;
+    m_endIndex = 0;
+    m_compactedProcesses = 0;
 }
 
 void LogFile::Add(const Message& msg)
 {
-    auto props = m_processInfo.GetProcessProperties(msg.processId, WStr(msg.processName).str());
-    m_messages.emplace_back(InternalMessage(msg.time, msg.systemTime, props.uid));
+    Add(MessageRef(msg));
+}
+
+void LogFile::Add(const MessageRef& msg)
+{
+    auto uid = m_processInfo.GetUid(msg.processId, msg.processName, FileTimeToUInt64(msg.processStartTime));
     m_storage.Add(msg.text);
+    AddMetadata(InternalMessage(msg.time, msg.systemTime, uid));
+    EnforceHistorySize();
+}
+
+void LogFile::AddMetadata(const InternalMessage& msg)
+{
+    if (m_writeMessages.empty())
+    {
+        m_blocks.emplace_back(msg);
+    }
+    m_writeMessages.push_back(msg);
+    ++m_endIndex;
+
+    auto& block = m_blocks.back();
+    block.minTime = std::min(block.minTime, msg.time);
+    block.maxTime = std::max(block.maxTime, msg.time);
+    block.maxSystemTime = std::max(block.maxSystemTime, FileTimeToUInt64(msg.systemTime));
+    if (!block.anyProcess && std::find(block.uids.begin(), block.uids.end(), msg.uid) == block.uids.end())
+    {
+        if (block.uids.size() < maxBlockProcesses)
+        {
+            block.uids.push_back(msg.uid);
+        }
+        else
+        {
+            block.anyProcess = true;
+            block.uids.clear();
+            block.uids.shrink_to_fit();
+        }
+    }
+
+    if (m_writeMessages.size() == blockLines)
+    {
+        block.columns = EncodeColumns(m_writeMessages);
+        block.columns.shrink_to_fit();
+        m_writeMessages.clear();
+    }
+}
+
+const LogFile::MetadataBlock& LogFile::GetBlock(int index) const
+{
+    return m_blocks[index / blockLines - m_beginIndex / blockLines];
+}
+
+int LogFile::GetBlockEnd(int index) const
+{
+    return std::min((index / blockLines + 1) * blockLines, EndIndex());
+}
+
+// lines of the last block are read from m_writeMessages, the most recently read full block is kept decoded
+const LogFile::InternalMessage& LogFile::GetMetadata(int index) const
+{
+    auto blockIndex = index / blockLines;
+    if (blockIndex == m_endIndex / blockLines)
+    {
+        return m_writeMessages[index % blockLines];
+    }
+
+    if (blockIndex != m_readBlock)
+    {
+        DecodeColumns(GetBlock(index).columns, blockLines, m_readMessages);
+        m_readBlock = blockIndex;
+    }
+    return m_readMessages[index % blockLines];
+}
+
+void LogFile::EnforceHistorySize()
+{
+    if (m_historySize <= 0)
+    {
+        return;
+    }
+
+    for (;;)
+    {
+        auto count = static_cast<int>(m_storage.FrontBlockCount());
+        if (count == 0 || Count() - count < m_historySize)
+        {
+            break;
+        }
+
+        m_storage.PopFrontBlock();
+        m_beginIndex += count;
+    }
+
+    // the front block holds line m_beginIndex
+    auto blocks = static_cast<size_t>((m_endIndex - 1) / blockLines - m_beginIndex / blockLines + 1);
+    while (m_blocks.size() > blocks)
+    {
+        m_blocks.pop_front();
+    }
+    CompactProcesses();
+}
+
+// forgets the processes of dropped lines once the number of processes has doubled since the last compaction
+void LogFile::CompactProcesses()
+{
+    if (m_processInfo.Count() < std::max(2 * m_compactedProcesses, minCompactProcesses))
+    {
+        return;
+    }
+
+    std::vector<DWORD> uids;
+    for (int index = m_beginIndex; index < m_endIndex; index = GetBlockEnd(index))
+    {
+        auto& block = GetBlock(index);
+        if (!block.anyProcess)
+        {
+            uids.insert(uids.end(), block.uids.begin(), block.uids.end());
+            continue;
+        }
+
+        for (int i = index; i < GetBlockEnd(index); ++i)
+        {
+            uids.push_back(GetMetadata(i).uid);
+        }
+    }
+    m_processInfo.Compact(uids);
+    m_compactedProcesses = m_processInfo.Count();
 }
 
 int LogFile::BeginIndex() const
 {
-    return 0;
+    return m_beginIndex;
 }
 
 int LogFile::EndIndex() const
 {
-    return static_cast<int>(m_messages.size());
+    return m_endIndex;
 }
 
 int LogFile::Count() const
 {
-    return static_cast<int>(m_messages.size());
+    return m_endIndex - m_beginIndex;
 }
 
 Message LogFile::operator[](int i) const
 {
-    auto& msg = m_messages[i];
-    auto props = m_processInfo.GetProcessProperties(msg.uid);
-    return Message(msg.time, msg.systemTime, props.pid, Str(props.name).str(), m_storage[i], props.color);
+    auto msg = GetMessageRef(i);
+    return Message(msg.time, msg.systemTime, msg.processId, std::string(msg.processName), std::string(msg.text), msg.color);
+}
+
+MessageRef LogFile::GetMessageRef(int i) const
+{
+    auto& msg = GetMetadata(i);
+    auto& props = m_processInfo.GetProcessPropertiesRef(msg.uid);
+    return MessageRef(msg.time, msg.systemTime, props.pid, props.utf8Name, m_storage.View(i), props.color);
+}
+
+// decodes the storage blocks of lines [beginIndex, endIndex] ahead of their use
+void LogFile::Prefetch(int beginIndex, int endIndex) const
+{
+    m_storage.Prefetch(beginIndex, endIndex);
+}
+
+void LogFile::PrefetchAhead(int index) const
+{
+    if (index % prefetchLines == 0)
+    {
+        m_storage.Prefetch(index + prefetchLines, index + 2 * prefetchLines - 1);
+    }
+}
+
+bool LogFile::MayMatch(int index, const LineQuery& query) const
+{
+    auto& block = GetBlock(index);
+    if (block.maxTime < query.beginTime || block.minTime > query.endTime)
+    {
+        return false;
+    }
+
+    if (query.processFilter && !block.anyProcess &&
+        std::none_of(block.uids.begin(), block.uids.end(), [&](DWORD uid) { return query.processFilter(m_processInfo.GetProcessPropertiesRef(uid).utf8Name); }))
+    {
+        return false;
+    }
+
+    return query.textAnyOf.empty() ||
+           std::any_of(query.textAnyOf.begin(), query.textAnyOf.end(), [&](const std::string& text) { return m_storage.MayContain(index, text); });
+}
+
+// steps through the intersections of metadata blocks and storage blocks
+LineRange LogFile::NextCandidates(int index, const LineQuery& query) const
+{
+    auto endIndex = EndIndex();
+    while (index < endIndex)
+    {
+        auto end = std::min(GetBlockEnd(index), static_cast<int>(m_storage.GetBlockEnd(index)));
+        if (MayMatch(index, query))
+        {
+            return LineRange{index, end};
+        }
+        index = end;
+    }
+    return LineRange{endIndex, endIndex};
+}
+
+// finds the first block with a line that is not before, then the line in that block
+template <typename BlockBefore, typename LineBefore>
+int LogFile::LowerBound(BlockBefore blockBefore, LineBefore lineBefore) const
+{
+    auto it = std::partition_point(m_blocks.begin(), m_blocks.end(), blockBefore);
+    if (it == m_blocks.end())
+    {
+        return EndIndex();
+    }
+
+    auto index = std::max((m_beginIndex / blockLines + static_cast<int>(it - m_blocks.begin())) * blockLines, m_beginIndex);
+    auto count = GetBlockEnd(index) - index;
+    while (count > 0)
+    {
+        auto step = count / 2;
+        if (lineBefore(GetMetadata(index + step)))
+        {
+            index += step + 1;
+            count -= step + 1;
+        }
+        else
+        {
+            count = step;
+        }
+    }
+    return index;
+}
+
+int LogFile::LowerBoundByTime(double time) const
+{
+    return LowerBound(
+        [time](const MetadataBlock& block) { return block.maxTime < time; },
+        [time](const InternalMessage& msg) { return msg.time < time; });
+}
+
+int LogFile::LowerBoundBySystemTime(const FILETIME& systemTime) const
+{
+    auto value = FileTimeToUInt64(systemTime);
+    return LowerBound(
+        [value](const MetadataBlock& block) { return block.maxSystemTime < value; },
+        [value](const InternalMessage& msg) { return FileTimeToUInt64(msg.systemTime) < value; });
 }
 
 int LogFile::GetHistorySize() const
@@ -77,6 +420,16 @@ void LogFile::SetHistorySize(int size)
     m_historySize = size;
 }
 
+size_t LogFile::GetMemoryBudget() const
+{
+    return m_storage.GetMemoryBudget();
+}
+
+void LogFile::SetMemoryBudget(size_t bytes)
+{
+    m_storage.SetMemoryBudget(bytes);
+}
+
 void LogFile::Append(const LogFile& logfile, int beginIndex, int endIndex)
 {
     for (int i = beginIndex; i <= endIndex; ++i)
@@ -6,6 +6,8 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <atomic>
+#include <mutex>
 #include "CobaltFusion/Str.h"
 #include "DebugView++Lib/LogSource.h"
 #include "DebugView++Lib/LineBuffer.h"
@@ -14,14 +16,71 @@
 namespace fusion {
 namespace debugviewpp {
 
+const uint32_t maxSourceSlots = 4096;
+
+// the generation of a slot is incremented when its source is destroyed,
+// lines that carry an older generation belong to a destroyed source.
+class SourceSlots
+{
+public:
+    SourceSlots() :
+        m_generations(maxSourceSlots)
+    {
+        for (uint32_t slot = maxSourceSlots - 1; slot > 0; --slot)
+        {
+            m_freeSlots.push_back(slot);
+        }
+    }
+
+    SourceId Allocate()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_freeSlots.empty())
+        {
+            throw std::runtime_error("Too many log sources");
+        }
+        auto slot = m_freeSlots.back();
+        m_freeSlots.pop_back();
+        return SourceId{slot, m_generations[slot].load(std::memory_order_relaxed)};
+    }
+
+    void Release(SourceId id)
+    {
+        m_generations[id.slot].fetch_add(1, std::memory_order_release);
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_freeSlots.push_back(id.slot);
+    }
+
+    bool Exists(SourceId id) const
+    {
+        return id.slot != 0 && m_generations[id.slot].load(std::memory_order_acquire) == id.generation;
+    }
+
+private:
+    std::vector<std::atomic<uint32_t>> m_generations;
+    std::mutex m_mutex;
+    std::vector<uint32_t> m_freeSlots;
+};
+
+SourceSlots& GetSourceSlots()
+{
+    static SourceSlots slots;
+    return slots;
+}
+
 LogSource::LogSource(Timer& timer, SourceType::type sourceType, ILineBuffer& linebuffer) :
     m_linebuffer(linebuffer),
     m_sourceType(sourceType),
-    m_timer(timer)
+    m_timer(timer),
+    m_sourceId(GetSourceSlots().Allocate()),
+    m_droppedLines(0)
 {
 }
 
-LogSource::~LogSource() = default;
+LogSource::~LogSource()
+{
+    GetSourceSlots().Release(m_sourceId);
+}
 
 void LogSource::SetAutoNewLine(bool value)
 {
@@ -55,6 +114,25 @@ void LogSource::PreProcess(Line& line) const
     }
 }
 
+void LogSource::OnProcessEnded(DWORD /*pid*/)
+{
+}
+
+bool LogSource::AllowsBlocking() const
+{
+    return false;
+}
+
+size_t LogSource::GetDroppedLines() const
+{
+    return m_droppedLines;
+}
+
+void LogSource::AddDroppedLine() const
+{
+    ++m_droppedLines;
+}
+
 std::wstring LogSource::GetDescription() const
 {
     return m_description;
@@ -70,6 +148,16 @@ SourceType::type LogSource::GetSourceType() const
     return m_sourceType;
 }
 
+SourceId LogSource::GetSourceId() const
+{
+    return m_sourceId;
+}
+
+bool LogSource::Exists(SourceId id)
+{
+    return GetSourceSlots().Exists(id);
+}
+
 void LogSource::Add(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message)
 {
     m_linebuffer.Add(time, systemTime, pid, processName, message, this);
@@ -85,6 +173,11 @@ void LogSource::Add(HANDLE handle, const std::string& message) const
     m_linebuffer.Add(m_timer.Get(), Win32::GetSystemTimeAsFileTime(), handle, message, this);
 }
 
+void LogSource::Add(double time, FILETIME systemTime, HANDLE handle, const std::string& message) const
+{
+    m_linebuffer.Add(time, systemTime, handle, message, this);
+}
+
 void LogSource::Add(const std::string& message)
 {
     m_linebuffer.Add(m_timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "", message, this);
@@ -95,5 +188,10 @@ void LogSource::AddInternal(const std::string& message) const
     m_linebuffer.Add(m_timer.Get(), Win32::GetSystemTimeAsFileTime(), 0, "[internal]", message, this);
 }
 
+double LogSource::GetTime() const
+{
+    return m_timer.Get();
+}
+
 } // namespace debugviewpp
 } // namespace fusion
@@ -7,6 +7,7 @@
 
 #include "stdafx.h"
 #include <cassert>
+#include <algorithm>
 #include <iostream>
 #include <chrono>
 #include <boost/algorithm/string.hpp>
@@ -28,11 +29,12 @@
 #include "DebugView++Lib/ProcessInfo.h"
 #include "DebugView++Lib/Conversions.h"
 #include "DebugView++Lib/LineBuffer.h"
-#include "DebugView++Lib/VectorLineBuffer.h"
+#include "DebugView++Lib/RingLineBuffer.h"
 #include "DebugView++Lib/Loopback.h"
 
 // class Logsources has a vector<LogSource> and start a thread for LogSources::Listen()
-// - Listen() exectues every LogSource::GetHandle() in m_sources and calls Notify() for any signaled handle.
+// - Listen() applies the scheduled additions and removals of m_sources and spreads the sources over ListenerShards,
+//   every shard waits for the LogSource::GetHandle() of up to 63 sources and calls Notify() for any signaled handle.
 // - LogSource::Notify reads input en writes to linebuffer (passed at construction)
 //
 
@@ -43,11 +45,12 @@ using namespace std::chrono_literals;
 
 LogSources::LogSources(IExecutor& executor, bool startListening) :
     m_updateEvent(CreateEvent(nullptr, 0, 0, nullptr)),
-    m_linebuffer(64 * 1024),
+    m_linebuffer(16 * 1024),
     m_loopback(std::make_unique<Loopback>(m_timer, m_linebuffer)),
     m_executor(executor),
     m_throttledUpdate(m_executor, 25, [&] { m_update(); })
 {
+    m_linebuffer.SetMarkerSource(m_loopback.get());
     m_processMonitor.ConnectProcessEnded([this](DWORD pid, HANDLE handle) { OnProcessEnded(pid, handle); });
     if (startListening)
     {
@@ -162,11 +165,27 @@ bool LogSources::GetProcessPrefix() const
     return m_processPrefix;
 }
 
+void LogSources::SetIngestBudget(const IngestBudget& budget)
+{
+    m_linebuffer.SetBudget(budget);
+}
+
+IngestBudget LogSources::GetIngestBudget() const
+{
+    return m_linebuffer.GetBudget();
+}
+
+size_t LogSources::GetDroppedLines() const
+{
+    return m_linebuffer.GetDroppedLines();
+}
+
 void LogSources::Abort()
 {
     m_processMonitor.Abort();
     m_update.disconnect_all_slots();
     m_end = true;
+    m_linebuffer.Abort(); // producers waiting for room would keep the sources from stopping
 
     CallSources([](LogSource* logsource) { logsource->Abort(); });
     RemoveSources([](LogSource* /*unused*/) { return true; });
@@ -191,10 +210,14 @@ void LogSources::Listen()
 {
     try
     {
-        ListenUntilUpdateEvent();
-        if (!m_end)
+        for (;;)
         {
-            m_listenThread.CallAsync([this] { Listen(); });
+            UpdateSources();
+            if (m_end)
+            {
+                return;
+            }
+            Win32::WaitForSingleObject(m_updateEvent);
         }
     }
     catch (const std::exception& e)
@@ -204,58 +227,6 @@ void LogSources::Listen()
     }
 }
 
-void LogSources::ListenUntilUpdateEvent()
-{
-    UpdateSources();
-
-    std::vector<HANDLE> waitHandles;
-    std::vector<LogSource*> sources;
-    {
-        for (auto& source : m_sources)
-        {
-            if (source->AtEnd())
-            {
-                continue;
-            }
-            HANDLE handle = source->GetHandle();
-            assert(handle != nullptr && "GetHandle() cant return nullptr");
-            if (handle != INVALID_HANDLE_VALUE)
-            {
-                waitHandles.push_back(handle);
-                sources.push_back(source.get());
-            }
-            // here LogSource::Initialize is called on the m_listenThread, currently only FileReader::Initialize uses this to start reading from the file.
-            // This will block all other logsources while the file is being read (which is normally not a problem)
-            source->Initialize();
-        }
-    }
-
-    auto updateEventIndex = waitHandles.size();
-    waitHandles.push_back(m_updateEvent.get());
-    while (!m_end)
-    {
-        auto res = Win32::WaitForAnyObject(waitHandles, INFINITE);
-        if (m_end)
-        {
-            return;
-        }
-
-        if (res.signaled)
-        {
-            int index = res.index - WAIT_OBJECT_0;
-            if (index == updateEventIndex)
-            {
-                break;
-            }
-
-            assert((index < static_cast<int>(sources.size())) && "res.index out of range");
-            auto logsource = sources[index];
-            logsource->Notify();
-            m_throttledUpdate();
-        }
-    }
-}
-
 void LogSources::UpdateSources()
 {
     std::vector<std::unique_ptr<LogSource>> sourcesToAdd;
@@ -268,6 +239,8 @@ void LogSources::UpdateSources()
 
     if (m_end)
     {
+        m_sourceShards.clear();
+        m_shards.clear();
         for (auto const& pLogSource : m_sources)
         {
             pLogSource->Abort();
@@ -276,6 +249,7 @@ void LogSources::UpdateSources()
         return;
     }
 
+    RemoveFromShards(sourcesToRemove);
     for (auto pLogSource : sourcesToRemove)
     {
         pLogSource->Abort();
@@ -285,12 +259,58 @@ void LogSources::UpdateSources()
     for (auto&& pLogSource : sourcesToAdd)
     {
         UpdateSettings(pLogSource);
+        // here LogSource::Initialize is called on the m_listenThread, currently only BinaryFileReader::Initialize uses this to read the file.
+        // This will block adding and removing other logsources while the file is being read (which is normally not a problem)
+        pLogSource->Initialize();
+        AddToShard(pLogSource.get());
         m_sources.emplace_back(std::move(pLogSource));
     }
 
     m_throttledUpdate(); // notify observers to process internal messages
 }
 
+void LogSources::AddToShard(LogSource* pSource)
+{
+    if (pSource->AtEnd() || pSource->GetHandle() == INVALID_HANDLE_VALUE)
+    {
+        return;
+    }
+    assert(pSource->GetHandle() != nullptr && "GetHandle() cant return nullptr");
+
+    auto it = std::find_if(m_shards.begin(), m_shards.end(), [](const std::unique_ptr<ListenerShard>& pShard) { return pShard->Count() < ListenerShard::maxSources; });
+    if (it == m_shards.end())
+    {
+        m_shards.push_back(std::make_unique<ListenerShard>([this] { m_throttledUpdate(); }));
+        it = m_shards.end() - 1;
+    }
+    (*it)->Add(pSource);
+    m_sourceShards[pSource] = it->get();
+}
+
+// returns when no shard uses the sources anymore, shards that become empty are stopped
+void LogSources::RemoveFromShards(const std::vector<LogSource*>& sources)
+{
+    std::vector<ListenerShard*> shards;
+    for (auto pSource : sources)
+    {
+        auto it = m_sourceShards.find(pSource);
+        if (it == m_sourceShards.end())
+        {
+            continue;
+        }
+        it->second->Remove(pSource);
+        shards.push_back(it->second);
+        m_sourceShards.erase(it);
+    }
+
+    for (auto pShard : shards)
+    {
+        pShard->Synchronize();
+    }
+
+    m_shards.erase(std::remove_if(m_shards.begin(), m_shards.end(), [](const std::unique_ptr<ListenerShard>& pShard) { return pShard->Count() == 0; }), m_shards.end());
+}
+
 std::string FormatExitCode(DWORD exitCode)
 {
     auto longCode = static_cast<long>(exitCode);
@@ -344,6 +364,7 @@ void LogSources::OnProcessEnded(DWORD pid, HANDLE handle)
             m_loopback->Add(line.pid, line.processName, line.message);
         }
         AddTerminateMessage(pid, handle);
+        CallSources([pid](LogSource* pSource) { pSource->OnProcessEnded(pid); });
         m_throttledUpdate();
         auto it = m_pidMap.find(pid);
         if (it != m_pidMap.end())
@@ -353,30 +374,19 @@ void LogSources::OnProcessEnded(DWORD pid, HANDLE handle)
     });
 }
 
-bool LogSources::IsRemoved(const LogSource* logsource) const
+// sources are destroyed when they are removed, checking the id does not need to lock or scan m_sources
+bool LogSources::IsRemoved(SourceId id) const
 {
-    // the loopback is a special LogSource that is never added to m_sources
-    if (logsource == m_loopback.get())
-        return false;
-
-    bool present = false;
-    CallSources([&](const LogSource* l) {
-        if (l == logsource)
-        {
-            present = true;
-        }
-    });
-    return !present;
+    return !LogSource::Exists(id);
 }
 
-Lines LogSources::GetLines()
+void LogSources::GetLines(LineBatch& lines)
 {
     assert(m_executor.IsExecutorThread());
-    Lines lines;
 
     for (auto&& inputLine : m_linebuffer.GetLines())
     {
-        if (IsRemoved(inputLine.pLogSource))
+        if (IsRemoved(inputLine.sourceId))
         {
             std::cerr << "'" << inputLine.message << "' ignored because source was removed\n";
             continue;
@@ -391,6 +401,7 @@ Lines LogSources::GetLines()
         {
             Win32::Handle handle(inputLine.handle);
             inputLine.pid = GetProcessId(inputLine.handle);
+            inputLine.processStartTime = ProcessInfo::GetCreationTime(inputLine.handle);
 
             auto it = m_pidMap.find(inputLine.pid);
             if (it == m_pidMap.end())
@@ -406,21 +417,31 @@ Lines LogSources::GetLines()
 
         if (inputLine.message.empty())
         {
-            lines.emplace_back(std::move(inputLine));
+            lines.Add(inputLine, inputLine.message);
         }
         else
         {
             // since a line can contain multiple newlines, processing 1 line can output
             // multiple lines, in this case the timestamp for each line is the same.
             // NewlineFilter::Process will also eat any \r\n's
-
-            for (auto&& line : m_newlineFilter.Process(std::move(inputLine)))
-            {
-                lines.emplace_back(std::move(line));
-            }
+            m_newlineFilter.Process(inputLine, lines);
         }
     }
+}
 
+Lines LogSources::GetLines()
+{
+    LineBatch batch;
+    GetLines(batch);
+
+    Lines lines;
+    lines.reserve(batch.Count());
+    for (size_t i = 0; i < batch.Count(); ++i)
+    {
+        auto line = batch[i];
+        lines.emplace_back(line.time, line.systemTime, line.pid, std::string(line.processName), std::string(line.message), line.pLogSource);
+        lines.back().processStartTime = line.processStartTime;
+    }
     return lines;
 }
 
@@ -7,6 +7,8 @@
 
 #include "stdafx.h"
 #include <cassert>
+#include <algorithm>
+#include <cctype>
 #include <stdexcept>
 #include "DebugView++Lib/MatchType.h"
 
@@ -84,6 +86,134 @@ std::string MakePattern(MatchType::type type, const std::string& text)
     return text;
 }
 
+// returns the position of the ']' that closes the class opened at pattern[i], or pattern.size()
+size_t SkipClass(const std::string& pattern, size_t i)
+{
+    for (++i; i < pattern.size() && pattern[i] != ']'; ++i)
+    {
+        if (pattern[i] == '\\')
+        {
+            ++i;
+        }
+    }
+    return i;
+}
+
+// returns the position of the ')' that closes the group opened at pattern[i], or pattern.size()
+size_t SkipGroup(const std::string& pattern, size_t i)
+{
+    int depth = 0;
+    for (; i < pattern.size(); ++i)
+    {
+        switch (pattern[i])
+        {
+        case '\\': ++i; break;
+        case '[': i = SkipClass(pattern, i); break;
+        case '(': ++depth; break;
+        case ')':
+            if (--depth == 0)
+            {
+                return i;
+            }
+            break;
+        default: break;
+        }
+    }
+    return i;
+}
+
+// the character of an escape that matches itself, or 0
+char EscapedCharacter(char c)
+{
+    switch (c)
+    {
+    case 't': return '\t';
+    case 'n': return '\n';
+    case 'r': return '\r';
+    case 'f': return '\f';
+    case 'v': return '\v';
+    default: break;
+    }
+    bool alphaNumeric = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9');
+    return alphaNumeric ? 0 : c;
+}
+
+// a conservative scan: a literal ends at anything but a plain or escaped character, a group or class
+// is skipped as a whole and a quantifier that allows zero repeats takes the last character off the literal.
+// An alternation outside a group means no literal is required at all.
+std::string GetRequiredLiteral(const std::string& pattern)
+{
+    std::string longest;
+    std::string literal;
+    auto endLiteral = [&]() {
+        if (literal.size() > longest.size())
+        {
+            longest = literal;
+        }
+        literal.clear();
+    };
+
+    for (size_t i = 0; i < pattern.size(); ++i)
+    {
+        switch (pattern[i])
+        {
+        case '|':
+        case ')': return std::string();
+        case '(':
+            endLiteral();
+            i = SkipGroup(pattern, i);
+            break;
+        case '[':
+            endLiteral();
+            i = SkipClass(pattern, i);
+            break;
+        case '.':
+        case '^':
+        case '$':
+        case '+': endLiteral(); break;
+        case '*':
+        case '?':
+        case '{':
+            if (!literal.empty())
+            {
+                literal.pop_back();
+            }
+            endLiteral();
+            if (pattern[i] == '{')
+            {
+                i = std::min(pattern.find('}', i), pattern.size());
+            }
+            break;
+        case '\\':
+            if (i + 1 < pattern.size() && EscapedCharacter(pattern[i + 1]) != 0)
+            {
+                literal += EscapedCharacter(pattern[++i]);
+            }
+            else
+            {
+                // a class like \d, an assertion, a back reference or a character code like \x41
+                endLiteral();
+                auto c = ++i < pattern.size() ? pattern[i] : '\0';
+                if (c == 'c')
+                {
+                    ++i;
+                }
+                else if (c == 'x' || c == 'u' || std::isdigit(static_cast<unsigned char>(c)))
+                {
+                    while (i + 1 < pattern.size() && std::isxdigit(static_cast<unsigned char>(pattern[i + 1])))
+                    {
+                        ++i;
+                    }
+                }
+            }
+            break;
+        default: literal += pattern[i]; break;
+        }
+    }
+    endLiteral();
+    return longest;
+}
+
 int MatchTypeToInt(MatchType::type value)
 {
 #define MATCH_TYPE(f, id) \
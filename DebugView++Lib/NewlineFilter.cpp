@@ -11,45 +11,134 @@
 #include "DebugView++Lib/ProcessInfo.h"
 #include "DebugView++Lib/NewlineFilter.h"
 #include <iostream>
+#include <string_view>
+
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__)
+#define NEWLINEFILTER_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
 namespace fusion {
 namespace debugviewpp {
 
-Lines NewlineFilter::Process(const Line& line)
+const size_t maxLineSize = 8192; // 8k line limit prevents stack overflow in handling code
+
+size_t CountTrailingZeros(unsigned mask)
 {
-    auto& message = m_lineBuffers[line.pid];
-    message.reserve(512);
+#ifdef _MSC_VER
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return index;
+#else
+    return __builtin_ctz(mask);
+#endif
+}
 
-    Lines lines;
-    for (auto c : line.message)
+// returns the position of the first '\n' or '\r' in [begin, end), or end
+size_t FindLineBreak(const char* data, size_t begin, size_t end)
+{
+    auto i = begin;
+#ifdef NEWLINEFILTER_SSE2
+    const auto newline = _mm_set1_epi8('\n');
+    const auto carriageReturn = _mm_set1_epi8('\r');
+    for (; i + 16 <= end; i += 16)
+    {
+        auto chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(data + i));
+        auto mask = _mm_movemask_epi8(_mm_or_si128(_mm_cmpeq_epi8(chars, newline), _mm_cmpeq_epi8(chars, carriageReturn)));
+        if (mask != 0)
+        {
+            return i + CountTrailingZeros(static_cast<unsigned>(mask));
+        }
+    }
+#endif
+    for (; i < end; ++i)
     {
-        if (c == '\r')
+        if (data[i] == '\n' || data[i] == '\r')
         {
-            continue;
+            return i;
         }
+    }
+    return end;
+}
+
+// complete lines go from the message into the batch as they are, only a partial line or a line
+// with a stray '\r' is copied into the carry buffer of the process.
+void NewlineFilter::Process(const Line& line, LineBatch& lines)
+{
+    std::string_view text = line.message;
+    auto it = m_lineBuffers.find(line.pid);
+    std::string* carry = it == m_lineBuffers.end() ? nullptr : &it->second;
 
-        if (c == '\n')
+    size_t begin = 0;
+    for (;;)
+    {
+        auto i = FindLineBreak(text.data(), begin, text.size());
+        if (i == text.size())
         {
-            Line outputLine(line.time, line.systemTime, line.pid, line.processName, "", line.pLogSource);
-            std::swap(outputLine.message, message);
-            lines.emplace_back(std::move(outputLine));
+            break;
+        }
+
+        auto end = i + 1;
+        if (text[i] == '\r')
+        {
+            if (end == text.size() || text[end] != '\n')
+            {
+                if (carry == nullptr)
+                {
+                    carry = &m_lineBuffers[line.pid];
+                }
+                carry->append(text.substr(begin, i - begin));
+                begin = end;
+                continue;
+            }
+            ++end;
+        }
+
+        if (carry == nullptr || carry->empty())
+        {
+            lines.Add(line, text.substr(begin, i - begin));
         }
         else
         {
-            message.push_back(c);
+            carry->append(text.substr(begin, i - begin));
+            lines.Add(line, *carry);
+            carry->clear();
         }
+        begin = end;
     }
 
-    if (!message.empty())
+    auto tail = text.substr(begin);
+    auto carrySize = carry == nullptr ? 0 : carry->size();
+    if (carrySize + tail.size() == 0)
     {
-        if (line.pLogSource->GetAutoNewLine() || message.size() > 8192) // 8k line limit prevents stack overflow in handling code
+        return;
+    }
+
+    if (line.pLogSource->GetAutoNewLine() || carrySize + tail.size() > maxLineSize)
+    {
+        if (carrySize == 0)
         {
-            Line outputLine(line.time, line.systemTime, line.pid, line.processName, "", line.pLogSource);
-            std::swap(outputLine.message, message);
-            lines.emplace_back(std::move(outputLine));
+            lines.Add(line, tail);
+        }
+        else
+        {
+            carry->append(tail);
+            lines.Add(line, *carry);
+            carry->clear();
         }
     }
-    return lines;
+    else
+    {
+        if (carry == nullptr)
+        {
+            carry = &m_lineBuffers[line.pid];
+            carry->reserve(512);
+        }
+        carry->append(tail);
+    }
 }
 
 Lines NewlineFilter::FlushLinesFromTerminatedProcess(DWORD pid, HANDLE handle)
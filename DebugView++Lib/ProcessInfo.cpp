@@ -29,6 +29,7 @@ InternalProcessProperties::InternalProcessProperties() :
 InternalProcessProperties::InternalProcessProperties(DWORD pid, const std::wstring& name, COLORREF color) :
     pid(pid),
     name(name),
+    utf8Name(Str(name).str()),
     color(color)
 {
 }
@@ -50,6 +51,8 @@ void ProcessInfo::Clear()
 {
     m_unqiueId = 0;
     m_processProperties.clear();
+    m_index.clear();
+    m_names.clear();
 }
 
 size_t ProcessInfo::GetPrivateBytes()
@@ -81,13 +84,18 @@ std::wstring ProcessInfo::GetProcessName(HANDLE handle)
 }
 
 std::wstring ProcessInfo::GetStartTime(HANDLE handle)
+{
+    return WStr(GetTimeText(GetCreationTime(handle))).str();
+}
+
+FILETIME ProcessInfo::GetCreationTime(HANDLE handle)
 {
     FILETIME creation = {};
     FILETIME exit = {};
     FILETIME kernel = {};
     FILETIME user = {};
     GetProcessTimes(handle, &creation, &exit, &kernel, &user);
-    return WStr(GetTimeText(creation)).str();
+    return creation;
 }
 
 std::wstring ProcessInfo::GetProcessNameByPid(DWORD processId)
@@ -101,21 +109,57 @@ std::wstring ProcessInfo::GetProcessNameByPid(DWORD processId)
     return L"";
 }
 
-DWORD ProcessInfo::GetUid(DWORD processId, const std::wstring& processName)
+size_t ProcessInfo::ProcessKeyHash::operator()(const ProcessKey& key) const
+{
+    return std::hash<std::string_view>()(key.name) ^ (key.pid * 0x9E3779B9u);
+}
+
+bool ProcessInfo::ProcessKeyEqual::operator()(const ProcessKey& a, const ProcessKey& b) const
+{
+    return a.pid == b.pid && a.name == b.name;
+}
+
+std::string_view ProcessInfo::InternName(std::string_view name)
+{
+    return *m_names.emplace(name).first;
+}
+
+DWORD ProcessInfo::GetUid(DWORD processId, std::string_view processName, uint64_t startTime)
 {
-    for (auto& item : m_processProperties)
+    auto it = m_index.find(ProcessKey{processId, processName});
+    if (it != m_index.end())
     {
-        if (item.second.pid == processId && item.second.name == processName)
+        auto& entry = it->second;
+        if (startTime == 0 || entry.startTime == startTime)
         {
-            return item.first;
+            return entry.uid;
+        }
+        if (entry.startTime == 0)
+        {
+            entry.startTime = startTime;
+            return entry.uid;
         }
     }
 
-    DWORD index = m_unqiueId;
+    // a new process, or a new process that reuses the pid: lines of the old process keep the old uid
+    DWORD uid = m_unqiueId;
     ++m_unqiueId;
+    m_processProperties[uid] = InternalProcessProperties(processId, WStr(processName).str(), GetRandomProcessColor());
+
+    if (it != m_index.end())
+    {
+        it->second = IndexEntry{uid, startTime};
+    }
+    else
+    {
+        m_index.emplace(ProcessKey{processId, InternName(processName)}, IndexEntry{uid, startTime});
+    }
+    return uid;
+}
 
-    m_processProperties[index] = InternalProcessProperties(processId, processName, GetRandomProcessColor());
-    return index;
+DWORD ProcessInfo::GetUid(DWORD processId, const std::wstring& processName)
+{
+    return GetUid(processId, Str(processName).str());
 }
 
 ProcessProperties ProcessInfo::GetProcessProperties(DWORD processId, const std::wstring& processName)
@@ -138,5 +182,54 @@ ProcessProperties ProcessInfo::GetProcessProperties(DWORD uid) const
     return ProcessProperties(it->second);
 }
 
+size_t ProcessInfo::Count() const
+{
+    return m_processProperties.size();
+}
+
+// the index and the interned names are rebuilt from the processes that remain
+void ProcessInfo::Compact(const std::vector<DWORD>& uids)
+{
+    std::unordered_set<DWORD> keep(uids.begin(), uids.end());
+    for (auto it = m_processProperties.begin(); it != m_processProperties.end();)
+    {
+        if (keep.find(it->first) == keep.end())
+        {
+            it = m_processProperties.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    std::unordered_set<std::string> names;
+    std::unordered_map<ProcessKey, IndexEntry, ProcessKeyHash, ProcessKeyEqual> index;
+    for (auto& item : m_index)
+    {
+        if (m_processProperties.find(item.second.uid) != m_processProperties.end())
+        {
+            auto name = std::string_view(*names.emplace(item.first.name).first);
+            index.emplace(ProcessKey{item.first.pid, name}, item.second);
+        }
+    }
+    m_index.swap(index);
+    m_names.swap(names);
+}
+
+const InternalProcessProperties& ProcessInfo::GetProcessPropertiesRef(DWORD uid) const
+{
+    static const InternalProcessProperties unknown;
+
+    auto it = m_processProperties.find(uid);
+    assert(it != m_processProperties.end());
+    if (it == m_processProperties.end())
+    {
+        return unknown;
+    }
+
+    return it->second;
+}
+
 } // namespace debugviewpp
 } // namespace fusion
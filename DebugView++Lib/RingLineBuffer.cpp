@@ -0,0 +1,305 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <cstddef>
+#include <algorithm>
+#include <chrono>
+#include <iterator>
+#include "CobaltFusion/stringbuilder.h"
+#include "DebugView++Lib/RingLineBuffer.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+using namespace std::chrono_literals;
+
+RingLineBuffer::RingLineBuffer(size_t size, const IngestBudget& budget) :
+    m_mask(0),
+    m_writePosition(0),
+    m_readPosition(0),
+    m_overflow(false),
+    m_maxLines(budget.maxLines),
+    m_maxBytes(budget.maxBytes),
+    m_policy(budget.policy),
+    m_lines(0),
+    m_bytes(0),
+    m_droppedLines(0),
+    m_aborted(false),
+    m_pMarkerSource(nullptr),
+    m_lastTime(0.0),
+    m_lastSystemTime()
+{
+    size_t capacity = 2;
+    while (capacity < size)
+    {
+        capacity *= 2;
+    }
+    m_mask = capacity - 1;
+    m_slots = std::make_unique<Slot[]>(capacity);
+    for (size_t i = 0; i < capacity; ++i)
+    {
+        m_slots[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+void RingLineBuffer::SetBudget(const IngestBudget& budget)
+{
+    m_maxLines = budget.maxLines;
+    m_maxBytes = budget.maxBytes;
+    m_policy = budget.policy;
+}
+
+IngestBudget RingLineBuffer::GetBudget() const
+{
+    IngestBudget budget;
+    budget.maxLines = m_maxLines;
+    budget.maxBytes = m_maxBytes;
+    budget.policy = m_policy;
+    return budget;
+}
+
+void RingLineBuffer::SetMarkerSource(const LogSource* pSource)
+{
+    m_pMarkerSource = pSource;
+}
+
+void RingLineBuffer::Abort()
+{
+    m_aborted = true;
+    {
+        std::lock_guard<std::mutex> lock(m_roomMutex);
+    }
+    m_room.notify_all();
+}
+
+size_t RingLineBuffer::GetDroppedLines() const
+{
+    return m_droppedLines;
+}
+
+void RingLineBuffer::Add(double time, FILETIME systemTime, HANDLE handle, const std::string& message, const LogSource* pSource)
+{
+    Push(Line(time, systemTime, handle, message, pSource));
+}
+
+void RingLineBuffer::Add(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message, const LogSource* pSource)
+{
+    Push(Line(time, systemTime, pid, processName, message, pSource));
+}
+
+// once a line went to the overflow list, the following lines go there too to keep their order
+void RingLineBuffer::Push(Line&& line)
+{
+    if (!Reserve(line))
+    {
+        Drop(line);
+        return;
+    }
+
+    if (!m_overflow.load(std::memory_order_acquire) && TryPush(line))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_overflowMutex);
+    m_overflowLines.push_back(OverflowLine{std::move(line), 0});
+    m_overflow.store(true, std::memory_order_release);
+}
+
+// returns false when the line must be dropped. Only sources that allow it wait for room,
+// the wait is bounded so a lost wakeup or an aborted source cannot keep the producer here.
+// A line with a process handle is never dropped, the consumer closes the handle and monitors the process.
+bool RingLineBuffer::Reserve(const Line& line)
+{
+    auto bytes = line.message.size();
+    while (line.handle == nullptr && IsOverBudget(bytes))
+    {
+        auto policy = m_policy.load();
+        if (policy == IngestPolicy::DropOldest && DropOldestOverflowLine(line.pLogSource))
+        {
+            continue;
+        }
+
+        auto pSource = line.pLogSource;
+        if (policy != IngestPolicy::Block || pSource == nullptr || !pSource->AllowsBlocking() || pSource->AtEnd() || m_aborted)
+        {
+            return false;
+        }
+
+        std::unique_lock<std::mutex> lock(m_roomMutex);
+        m_room.wait_for(lock, 10ms, [&] { return !IsOverBudget(bytes) || m_aborted; });
+    }
+
+    ++m_lines;
+    m_bytes += bytes;
+    return true;
+}
+
+// an empty buffer takes any line, so a single line larger than the budget still gets through
+bool RingLineBuffer::IsOverBudget(size_t bytes) const
+{
+    auto lines = m_lines.load();
+    return lines > 0 && ((m_maxLines > 0 && lines >= m_maxLines) || (m_maxBytes > 0 && m_bytes + bytes > m_maxBytes));
+}
+
+// lines in the ring cannot be taken back by a producer, the oldest line of the overflow list without a process
+// handle is dropped instead and a marker takes its place.
+// The line may belong to a source that another thread is removing, so only the producer's own source counts it.
+bool RingLineBuffer::DropOldestOverflowLine(const LogSource* pProducer)
+{
+    std::lock_guard<std::mutex> lock(m_overflowMutex);
+    auto it = std::find_if(m_overflowLines.begin(), m_overflowLines.end(), [](const OverflowLine& overflowLine) { return overflowLine.dropped == 0 && overflowLine.line.handle == nullptr; });
+    if (it == m_overflowLines.end())
+    {
+        return false;
+    }
+
+    --m_lines;
+    m_bytes -= it->line.message.size();
+    ++m_droppedLines;
+    if (it->line.pLogSource != nullptr && it->line.pLogSource == pProducer)
+    {
+        pProducer->AddDroppedLine();
+    }
+
+    if (it != m_overflowLines.begin() && std::prev(it)->dropped > 0)
+    {
+        ++std::prev(it)->dropped;
+        m_overflowLines.erase(it);
+    }
+    else
+    {
+        it->line = Line();
+        it->dropped = 1;
+    }
+    return true;
+}
+
+// the newest line is dropped, a marker at the end of the overflow list keeps the position of the gap
+void RingLineBuffer::Drop(const Line& line)
+{
+    ++m_droppedLines;
+    if (line.pLogSource != nullptr)
+    {
+        line.pLogSource->AddDroppedLine();
+    }
+
+    std::lock_guard<std::mutex> lock(m_overflowMutex);
+    if (m_overflowLines.empty() || m_overflowLines.back().dropped == 0)
+    {
+        m_overflowLines.push_back(OverflowLine{Line(), 0});
+    }
+    ++m_overflowLines.back().dropped;
+    m_overflow.store(true, std::memory_order_release);
+}
+
+// a producer owns a slot after advancing the write position past it, the consumer
+// sees the line when the slot sequence is published (Vyukov's bounded queue)
+bool RingLineBuffer::TryPush(Line& line)
+{
+    auto position = m_writePosition.load(std::memory_order_relaxed);
+    for (;;)
+    {
+        auto& slot = m_slots[position & m_mask];
+        auto sequence = slot.sequence.load(std::memory_order_acquire);
+        auto difference = static_cast<std::ptrdiff_t>(sequence - position);
+        if (difference == 0)
+        {
+            if (m_writePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+            {
+                slot.line = std::move(line);
+                slot.sequence.store(position + 1, std::memory_order_release);
+                return true;
+            }
+        }
+        else if (difference < 0)
+        {
+            return false;
+        }
+        else
+        {
+            position = m_writePosition.load(std::memory_order_relaxed);
+        }
+    }
+}
+
+// takes at most one ring of lines so producers that keep adding cannot keep the consumer here,
+// a slot that is claimed but not yet written ends the batch.
+Lines RingLineBuffer::GetLines()
+{
+    auto position = m_readPosition.load(std::memory_order_relaxed);
+    Lines lines;
+    lines.reserve(std::min(m_writePosition.load(std::memory_order_relaxed) - position, m_mask + 1));
+    for (size_t i = 0; i <= m_mask; ++i)
+    {
+        auto& slot = m_slots[position & m_mask];
+        if (slot.sequence.load(std::memory_order_acquire) != position + 1)
+        {
+            break;
+        }
+        Take(std::move(slot.line), lines);
+        slot.sequence.store(position + m_mask + 1, std::memory_order_release);
+        ++position;
+    }
+    m_readPosition.store(position, std::memory_order_relaxed);
+
+    if (m_overflow.load(std::memory_order_acquire))
+    {
+        // a producer only adds to the overflow list after its earlier lines claimed their slots,
+        // take the overflow lines once those are all read to keep the order of each producer
+        std::lock_guard<std::mutex> lock(m_overflowMutex);
+        if (m_writePosition.load(std::memory_order_relaxed) == position)
+        {
+            for (auto& overflowLine : m_overflowLines)
+            {
+                if (overflowLine.dropped > 0)
+                {
+                    lines.push_back(CreateMarker(overflowLine.dropped));
+                }
+                else
+                {
+                    Take(std::move(overflowLine.line), lines);
+                }
+            }
+            m_overflowLines.clear();
+            m_overflow.store(false, std::memory_order_release);
+        }
+    }
+
+    if (!lines.empty())
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_roomMutex);
+        }
+        m_room.notify_all();
+    }
+    return lines;
+}
+
+void RingLineBuffer::Take(Line&& line, Lines& lines)
+{
+    --m_lines;
+    m_bytes -= line.message.size();
+    m_lastTime = line.time;
+    m_lastSystemTime = line.systemTime;
+    lines.push_back(std::move(line));
+}
+
+// a marker gets the time of the line before the gap
+Line RingLineBuffer::CreateMarker(size_t dropped) const
+{
+    return Line(m_lastTime, m_lastSystemTime, 0, "[internal]", stringbuilder() << dropped << " lines dropped", m_pMarkerSource);
+}
+
+bool RingLineBuffer::Empty() const
+{
+    return m_writePosition.load(std::memory_order_relaxed) == m_readPosition.load(std::memory_order_relaxed) && !m_overflow.load(std::memory_order_relaxed);
+}
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,181 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <random>
+#include <boost/test/unit_test.hpp>
+#include "CobaltFusion/stringbuilder.h"
+#include "CobaltFusion/Timer.h"
+#include "IndexedStorageLib/IndexedStorage.h"
+#include "DebugView++Lib/VectorLineBuffer.h"
+#include "DebugView++Lib/RingLineBuffer.h"
+#include "DebugView++Lib/LineBatch.h"
+#include "DebugView++Lib/NewlineFilter.h"
+#include "DebugView++Lib/TestSource.h"
+#include "TemplateStorage.h"
+#include "TestUtilities.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// measurements that take seconds and only report their results, run them with --run_test=Benchmarks
+BOOST_AUTO_TEST_SUITE(Benchmarks, *boost::unit_test::disabled())
+
+double MeasureSeconds(const std::function<void()>& run)
+{
+    Timer timer;
+    run();
+    return timer.Get();
+}
+
+void BenchmarkBlockLimits(const std::string& name, size_t blockBytes, size_t minLines, size_t maxLines)
+{
+    using namespace indexedstorage;
+
+    size_t testSize = 200000;
+    SnappyStorage s;
+    s.SetBlockLimits(blockBytes, minLines, maxLines);
+    s.SetCacheSize(0); // every block switch decodes, this measures the worst case row access
+
+    size_t rawBytes = 0;
+    for (size_t i = 0; i < testSize; ++i)
+    {
+        auto text = GetMixedTestString(i);
+        rawBytes += text.size();
+        s.Add(text);
+    }
+    s.Flush();
+
+    std::mt19937 generator;
+    std::uniform_int_distribution<size_t> distribution(0, testSize - 1);
+    size_t reads = 10000;
+    bool failed = false;
+    auto seconds = MeasureSeconds([&] {
+        for (size_t i = 0; i < reads; ++i)
+        {
+            size_t j = distribution(generator);
+            if (s.View(j).size() != GetMixedTestString(j).size())
+                failed = true;
+        }
+    });
+
+    BOOST_TEST(!failed);
+    BOOST_TEST_MESSAGE(name << ": " << rawBytes / 1024 << " kB stored in " << s.GetStorageSize() / 1024 << " kB (" << (100 * s.GetStorageSize()) / rawBytes << "%), "
+                            << "random access " << 1e6 * seconds / reads << " us/line");
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageBlockLimits)
+{
+    // compares the former fixed 400 line blocks with the default byte budget
+    BenchmarkBlockLimits("400 lines per block", std::numeric_limits<size_t>::max(), 400, 400);
+    BenchmarkBlockLimits("32 kB per block", 32 * 1024, 16, 4096);
+}
+
+template <typename Storage>
+void BenchmarkStorage(const std::string& name, Storage& s)
+{
+    size_t testSize = 200000;
+    size_t rawBytes = 0;
+    auto addSeconds = MeasureSeconds([&] {
+        for (size_t i = 0; i < testSize; ++i)
+        {
+            auto text = GetTemplateTestString(i);
+            rawBytes += text.size();
+            s.Add(text);
+        }
+        s.Flush();
+    });
+
+    size_t bytes = 0;
+    auto readSeconds = MeasureSeconds([&] {
+        for (size_t i = 0; i < testSize; ++i)
+            bytes += s.View(i).size();
+    });
+
+    BOOST_TEST(bytes == rawBytes);
+    BOOST_TEST_MESSAGE(name << ": " << rawBytes / 1024 << " kB stored in " << s.GetStorageSize() / 1024 << " kB (" << (100 * s.GetStorageSize()) / rawBytes << "%), "
+                            << "add " << 1e9 * addSeconds / testSize << " ns/line, sequential read " << 1e9 * readSeconds / testSize << " ns/line");
+}
+
+BOOST_AUTO_TEST_CASE(TemplateStorageCompression)
+{
+    indexedstorage::SnappyStorage snappy;
+    BenchmarkStorage("SnappyStorage", snappy);
+    indexedstorage::TemplateStorage templates;
+    BenchmarkStorage("TemplateStorage", templates);
+}
+
+BOOST_AUTO_TEST_CASE(LineBufferContention)
+{
+    const size_t producers = 8;
+    const size_t linesPerProducer = 100000;
+
+    bool ordered = false;
+    VectorLineBuffer vectorBuffer(16 * 1024);
+    auto vectorSeconds = RunLineBufferProducers(vectorBuffer, producers, linesPerProducer, ordered);
+    BOOST_TEST(ordered);
+
+    RingLineBuffer ringBuffer(16 * 1024);
+    auto ringSeconds = RunLineBufferProducers(ringBuffer, producers, linesPerProducer, ordered);
+    BOOST_TEST(ordered);
+
+    auto lines = static_cast<double>(producers * linesPerProducer);
+    BOOST_TEST_MESSAGE("VectorLineBuffer: " << 1e9 * vectorSeconds / lines << " ns/line, RingLineBuffer: " << 1e9 * ringSeconds / lines << " ns/line (" << producers << " producers)");
+}
+
+BOOST_AUTO_TEST_CASE(NewlineFilterThroughput)
+{
+    Timer timer;
+    VectorLineBuffer buffer(64);
+    TestSource source(timer, buffer);
+    source.SetAutoNewLine(false);
+    FILETIME ft = {};
+
+    // short DBWIN-like messages and 8 KB dumps of 80 character lines
+    std::string shortMessage(98, 'x');
+    shortMessage += "\r\n";
+    std::string dump;
+    while (dump.size() + 81 <= 8192)
+    {
+        dump += std::string(79, 'y') + "\n";
+    }
+
+    for (auto& message : {shortMessage, dump})
+    {
+        Line line(0.0, ft, 1, "test", message, &source);
+        NewlineFilter filter;
+        LineBatch lines;
+        const size_t totalBytes = 64 * 1024 * 1024;
+        size_t bytes = 0;
+        size_t messages = 0;
+        size_t count = 0;
+        auto seconds = MeasureSeconds([&] {
+            while (bytes < totalBytes)
+            {
+                filter.Process(line, lines);
+                bytes += message.size();
+                ++messages;
+                if (lines.Count() > 10000)
+                {
+                    count += lines.Count();
+                    lines.Clear();
+                }
+            }
+        });
+        count += lines.Count();
+        BOOST_TEST(count == messages * static_cast<size_t>(std::count(message.begin(), message.end(), '\n')));
+        BOOST_TEST_MESSAGE("NewlineFilter, " << message.size() << " byte messages: " << bytes / seconds / (1024 * 1024) << " MB/s");
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+} // namespace debugviewpp
+} // namespace fusion
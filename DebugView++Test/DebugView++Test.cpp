@@ -15,6 +15,8 @@
 #include <random>
 #include <fstream>
 #include <iostream>
+#include <limits>
+#include <thread>
 
 #include "Win32/Utilities.h"
 #include "Win32/Win32Lib.h"
@@ -24,25 +26,111 @@
 #include "IndexedStorageLib/IndexedStorage.h"
 #include "DebugView++Lib/ProcessInfo.h"
 #include "DebugView++Lib/DBWinBuffer.h"
+#include "DebugView++Lib/DBWinReader.h"
 #include "DebugView++Lib/LogSources.h"
 #include "DebugView++Lib/LogSource.h"
 #include "DebugView++Lib/TestSource.h"
 #include "DebugView++Lib/VectorLineBuffer.h"
+#include "DebugView++Lib/RingLineBuffer.h"
+#include "DebugView++Lib/LineBatch.h"
+#include "DebugView++Lib/NewlineFilter.h"
+#include "DebugView++Lib/FrameBudget.h"
+#include "DebugView++Lib/FilterStage.h"
+#include "DebugView++Lib/FilterProgram.h"
+#include "DebugView++Lib/FilterScan.h"
+#include "DebugView++Lib/LiteralMatcher.h"
 #include "DebugView++Lib/LogFile.h"
 #include "DebugView++Lib/FileIO.h"
 #include "DebugView++Lib/Conversions.h"
 #include "CobaltFusion/scope_guard.h"
+#include "TemplateStorage.h"
+#include "TestUtilities.h"
 
 namespace fusion {
 namespace debugviewpp {
 
-BOOST_AUTO_TEST_SUITE(DebugViewPlusPlusLib)
-
 std::string GetTestString(size_t i)
 {
     return stringbuilder() << "BB_TEST_ABCDEFGHI_EE_" << i;
 }
 
+// mostly short heartbeat lines with an occasional multi-kB stack dump
+std::string GetMixedTestString(size_t i)
+{
+    if (i % 500 == 0)
+    {
+        std::string dump = GetTestString(i);
+        for (int frame = 0; frame < 100; ++frame)
+        {
+            std::string line = stringbuilder() << "\n    at module!Function" << frame << "+" << frame * 16;
+            dump += line;
+        }
+        return dump;
+    }
+    return GetTestString(i);
+}
+
+// printf-style lines, plus fields that can not be stored as a number
+std::string GetTemplateTestString(size_t i)
+{
+    switch (i % 5)
+    {
+    case 0: return stringbuilder() << "OnTimer: tick " << i << " elapsed " << i * 1000 << " us";
+    case 1: return stringbuilder() << "Connection 10.0.0." << i % 256 << ":8080 state " << i % 3;
+    case 2: return stringbuilder() << "id 007 and 18446744073709551616 and -" << i;
+    case 3: return stringbuilder() << "marker \1 in text " << i;
+    default: return GetTestString(i);
+    }
+}
+
+// every producer adds its lines numbered by 'time', the consumer checks all lines arrive in order per producer
+double RunLineBufferProducers(ILineBuffer& buffer, size_t producers, size_t linesPerProducer, bool& ordered)
+{
+    Timer timer;
+    std::vector<std::thread> threads;
+    for (size_t p = 0; p < producers; ++p)
+    {
+        threads.emplace_back([&buffer, p, linesPerProducer]() {
+            FILETIME ft = {};
+            for (size_t i = 0; i < linesPerProducer; ++i)
+            {
+                buffer.Add(static_cast<double>(i), ft, static_cast<DWORD>(p), "producer", GetTestString(i), nullptr);
+            }
+        });
+    }
+
+    ordered = true;
+    std::vector<size_t> next(producers, 0);
+    size_t received = 0;
+    while (received < producers * linesPerProducer)
+    {
+        auto lines = buffer.GetLines();
+        if (lines.empty())
+        {
+            std::this_thread::yield();
+        }
+        for (auto& line : lines)
+        {
+            auto& expected = next[line.pid];
+            if (line.time != static_cast<double>(expected) || line.message != GetTestString(expected))
+            {
+                ordered = false;
+            }
+            ++expected;
+        }
+        received += lines.size();
+    }
+    double seconds = timer.Get();
+
+    for (auto& thread : threads)
+    {
+        thread.join();
+    }
+    return seconds;
+}
+
+BOOST_AUTO_TEST_SUITE(DebugViewPlusPlusLib)
+
 class TestLineBuffer : public LineBuffer
 {
 public:
@@ -306,6 +394,933 @@ BOOST_AUTO_TEST_CASE(LineBufferTest2) // test overflows boosttestui with log-out
     }
 }
 
+BOOST_AUTO_TEST_CASE(LogSourceIdGeneration)
+{
+    Timer timer;
+    TestLineBuffer buffer(64);
+    SourceId id;
+    {
+        TestSource source(timer, buffer);
+        source.Add(0, "test", "line of a living source");
+        id = source.GetSourceId();
+        BOOST_TEST(LogSource::Exists(id));
+    }
+    BOOST_TEST(!LogSource::Exists(id));
+    BOOST_TEST(!LogSource::Exists(SourceId()));
+
+    // a new source can reuse the slot, lines of the destroyed source stay dead
+    TestSource source(timer, buffer);
+    BOOST_TEST(LogSource::Exists(source.GetSourceId()));
+    BOOST_TEST(!LogSource::Exists(id));
+
+    auto lines = buffer.GetLines();
+    BOOST_TEST(lines.size() == 1);
+    BOOST_TEST(lines[0].sourceId.slot == id.slot);
+    BOOST_TEST(!LogSource::Exists(lines[0].sourceId));
+}
+
+BOOST_AUTO_TEST_CASE(LineBatchRecycle)
+{
+    LineBatch batch;
+    FILETIME ft = {};
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        batch.Add(static_cast<double>(i), ft, static_cast<DWORD>(i / 100), "process" + std::to_string(i / 100), GetTestString(i), nullptr);
+    }
+    BOOST_TEST(batch.Count() == 1000);
+    BOOST_TEST(batch[0].message == GetTestString(0));
+    BOOST_TEST(batch[999].processName == "process9");
+
+    batch.EraseFront(150);
+    BOOST_TEST(batch.Count() == 850);
+    bool failed = false;
+    for (size_t i = 0; i < batch.Count(); ++i)
+    {
+        auto line = batch[i];
+        if (line.time != static_cast<double>(i + 150) || line.message != GetTestString(i + 150) || line.processName != "process" + std::to_string((i + 150) / 100))
+            failed = true;
+    }
+    BOOST_TEST(!failed);
+
+    // a cleared batch holds the same amount of text without growing its arena
+    auto capacity = batch.GetArenaCapacity();
+    batch.Clear();
+    BOOST_TEST(batch.Empty());
+    for (size_t i = 0; i < 850; ++i)
+    {
+        batch.Add(0.0, ft, 1, "process", GetTestString(i), nullptr);
+    }
+    BOOST_TEST(batch.GetArenaCapacity() == capacity);
+    BOOST_TEST(batch[849].message == GetTestString(849));
+}
+
+BOOST_AUTO_TEST_CASE(NewlineFilterSplitLines)
+{
+    Timer timer;
+    TestLineBuffer buffer(64);
+    TestSource source(timer, buffer);
+    source.SetAutoNewLine(false);
+
+    NewlineFilter filter;
+    LineBatch lines;
+    FILETIME ft = {};
+    auto process = [&](DWORD pid, const std::string& message) {
+        filter.Process(Line(0.0, ft, pid, "test", message, &source), lines);
+    };
+
+    process(1, "first\r\nsec");
+    process(2, "other process\n");
+    process(1, "ond\nthird line is longer than sixteen characters\n\nstray\rcarriage return\n");
+    process(1, "trailing carriage return\r");
+    process(1, "\n");
+    BOOST_TEST(lines.Count() == 7);
+    BOOST_TEST(lines[0].message == "first");
+    BOOST_TEST(lines[1].message == "other process");
+    BOOST_TEST(lines[2].message == "second");
+    BOOST_TEST(lines[3].message == "third line is longer than sixteen characters");
+    BOOST_TEST(lines[4].message == "");
+    BOOST_TEST(lines[5].message == "straycarriage return");
+    BOOST_TEST(lines[6].message == "trailing carriage return");
+
+    process(1, "unterminated");
+    BOOST_TEST(lines.Count() == 7);
+    auto flushed = filter.FlushLinesFromTerminatedProcess(1, nullptr);
+    BOOST_TEST(flushed.size() == 1);
+    BOOST_TEST(flushed[0].message == "unterminated");
+
+    source.SetAutoNewLine(true);
+    process(1, "auto\nnewline");
+    BOOST_TEST(lines.Count() == 9);
+    BOOST_TEST(lines[8].message == "newline");
+}
+
+// simulated views with a fixed cost per line, the cost rises 50x as if a heavy filter was added
+BOOST_AUTO_TEST_CASE(FrameBudgetAdaptsBatchSize)
+{
+    FrameBudget budget(0.008);
+    double now = 0.0;
+    for (double lineCost : {1e-6, 50e-6, 0.2e-6})
+    {
+        for (int frame = 0; frame < 10; ++frame)
+        {
+            budget.BeginFrame(now);
+            auto start = now;
+            while (auto count = budget.NextBatch(now))
+            {
+                now += count * lineCost;
+                budget.EndBatch(count, count * lineCost);
+            }
+            auto elapsed = now - start;
+            BOOST_TEST(elapsed <= 2 * budget.GetBudget());
+            if (frame > 0)
+            {
+                BOOST_TEST(elapsed <= 1.25 * budget.GetBudget());
+                BOOST_TEST(elapsed >= 0.5 * budget.GetBudget());
+            }
+            now += 0.01;
+        }
+        BOOST_TEST(std::abs(budget.GetLineCost() - lineCost) < 0.1 * lineCost);
+    }
+}
+
+// the simple filters found by the LiteralMatcher give the same results as their std::regex
+BOOST_AUTO_TEST_CASE(LiteralMatcherMatchesSimpleFilters)
+{
+    std::mt19937 random(42);
+    auto randomText = [&](size_t maxLength) {
+        const char alphabet[] = "aAbB.*c[";
+        std::string text(random() % (maxLength + 1), ' ');
+        for (auto& c : text)
+        {
+            c = alphabet[random() % (sizeof(alphabet) - 1)];
+        }
+        return text;
+    };
+
+    for (int round = 0; round < 200; ++round)
+    {
+        std::vector<Filter> filters;
+        std::vector<std::string> patterns;
+        for (int i = 0; i < 8; ++i)
+        {
+            auto type = i % 3 == 0 ? FilterType::Exclude : FilterType::Include;
+            patterns.push_back(randomText(4));
+            filters.emplace_back(patterns.back(), MatchType::Simple, type);
+            filters.back().enable = i != 5;
+        }
+        filters.emplace_back("a.b", MatchType::Regex, FilterType::Include);
+        LiteralMatcher matcher(patterns);
+        SimpleFilters simpleFilters;
+        simpleFilters.Update(filters);
+
+        std::vector<char> found;
+        std::vector<char> hits;
+        MatchColors matchColors;
+        for (int i = 0; i < 20; ++i)
+        {
+            auto text = randomText(24);
+            matcher.Find(text, found);
+            for (size_t id = 0; id < patterns.size(); ++id)
+            {
+                bool expected = std::regex_search(text, std::regex(MakePattern(MatchType::Simple, patterns[id]), std::regex::icase));
+                BOOST_TEST((found[id] != 0) == expected);
+            }
+
+            simpleFilters.Find(text, hits);
+            BOOST_TEST(IsIncluded(filters, FilterText(text, &hits), matchColors) == IsIncluded(filters, text, matchColors));
+            BOOST_TEST(MatchFilterType(filters, FilterType::Exclude, FilterText(text, &hits)) == MatchFilterType(filters, FilterType::Exclude, text));
+        }
+    }
+
+    std::vector<Filter> filters;
+    for (int i = 0; i < 40; ++i)
+    {
+        filters.emplace_back(stringbuilder() << "keyword" << i, MatchType::Simple, i < 20 ? FilterType::Exclude : FilterType::Include);
+    }
+    SimpleFilters simpleFilters;
+    simpleFilters.Update(filters);
+    std::vector<char> hits;
+    MatchColors matchColors;
+    const int lines = 20000;
+    Timer timer;
+    int regexIncluded = 0;
+    for (int i = 0; i < lines; ++i)
+    {
+        regexIncluded += IsIncluded(filters, GetTestString(i), matchColors);
+    }
+    auto regexSeconds = timer.Get();
+    int literalIncluded = 0;
+    for (int i = 0; i < lines; ++i)
+    {
+        auto text = GetTestString(i);
+        simpleFilters.Find(text, hits);
+        literalIncluded += IsIncluded(filters, FilterText(text, &hits), matchColors);
+    }
+    auto literalSeconds = timer.Get() - regexSeconds;
+    BOOST_TEST(literalIncluded == regexIncluded);
+    BOOST_TEST_MESSAGE("40 Simple filters, std::regex: " << lines / regexSeconds << " lines/s, LiteralMatcher: " << lines / literalSeconds << " lines/s");
+}
+
+BOOST_AUTO_TEST_CASE(RequiredLiteralPrefilter)
+{
+    BOOST_TEST(GetRequiredLiteral(R"(conn.*timeout \d+)") == "timeout ");
+    BOOST_TEST(GetRequiredLiteral(R"(id=(\d+) state=(\w+))") == " state=");
+    BOOST_TEST(GetRequiredLiteral(R"(errors?)") == "error");
+    BOOST_TEST(GetRequiredLiteral(R"(\x41_name\.txt)") == "_name.txt");
+    BOOST_TEST(GetRequiredLiteral(R"(warning|error)") == "");
+    BOOST_TEST(GetRequiredLiteral(R"([a-z]+\d*)") == "");
+
+    // a text that matches the regex always contains the required literal, with or without SSE2
+    std::mt19937 random(7);
+    const char* patterns[] = {"a.*bc", "(ab)+c?d", "ab{2}c", R"(\babc\b)", "[abc]+dd", "x(a|b)yz", "A\\.B", "ca+b?c", "abcabcabcabcabcabcab", "aBC", "(?:ab)*cd"};
+    for (auto pattern : patterns)
+    {
+        for (auto matchType : {MatchType::Regex, MatchType::RegexCase})
+        {
+            Filter filter(pattern, matchType, FilterType::Include);
+            for (int i = 0; i < 2000; ++i)
+            {
+                const char alphabet[] = "abcdxyzABCD. ";
+                std::string text(random() % 48, ' ');
+                for (auto& c : text)
+                {
+                    c = alphabet[random() % (sizeof(alphabet) - 1)];
+                }
+                bool expected = std::regex_search(text, filter.re);
+                BOOST_TEST(IsMatch(filter, text) == expected);
+                BOOST_TEST((!expected || filter.required.IsIn(text)));
+            }
+        }
+    }
+
+    Filter filter(R"(conn.*timeout \d+)", MatchType::Regex, FilterType::Include);
+    const int lines = 20000;
+    Timer timer;
+    int regexMatches = 0;
+    for (int i = 0; i < lines; ++i)
+    {
+        auto text = GetTestString(i);
+        regexMatches += std::regex_search(text, filter.re);
+    }
+    auto regexSeconds = timer.Get();
+    int prefilterMatches = 0;
+    for (int i = 0; i < lines; ++i)
+    {
+        prefilterMatches += IsMatch(filter, GetTestString(i));
+    }
+    auto prefilterSeconds = timer.Get() - regexSeconds;
+    BOOST_TEST(prefilterMatches == regexMatches);
+    BOOST_TEST_MESSAGE("Regex filter, std::regex: " << lines / regexSeconds << " lines/s, with required literal: " << lines / prefilterSeconds << " lines/s");
+}
+
+// a Clear line resets the Once filters and auto colors before it is filtered, the later lines of the batch see that
+BOOST_AUTO_TEST_CASE(FilterMessagesClearResetsOnceFilters)
+{
+    LogFilter filter;
+    filter.messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filter.messageFilters.emplace_back("error", MatchType::Simple, FilterType::Once);
+    filter.messageFilters.emplace_back("clear", MatchType::Simple, FilterType::Clear);
+    filter.messageFilters.emplace_back("\\d\\d", MatchType::Regex, FilterType::Token, Colors::Auto);
+
+    std::vector<std::string> texts = {"text 10", "error 11", "error 12", "clear 13", "error 14", "error 15", "text 16", "error 17"};
+    std::vector<MessageRef> messages;
+    for (auto& text : texts)
+    {
+        messages.emplace_back(0.0, FILETIME(), 1, "test.exe", text);
+    }
+
+    FilterProgram program;
+    MatchColors matchColors;
+    std::vector<FilterMatch> matches;
+    FilterMessages(filter, program, matchColors, messages, 0, 7, 100, matches);
+    BOOST_REQUIRE(matches.size() == 5u);
+    BOOST_TEST(matches[0].line == 100);
+    BOOST_TEST(matches[1].line == 101);
+    BOOST_TEST(matches[2].line == 103);
+    BOOST_TEST(matches[2].clear);
+    BOOST_TEST(!matches[2].included);
+    BOOST_TEST(matches[3].line == 104);
+    BOOST_TEST(matches[3].included);
+    BOOST_TEST(matches[4].line == 106);
+    BOOST_TEST(filter.messageFilters[1].matched);
+    BOOST_TEST(matchColors.size() == 4u);
+    BOOST_TEST((matchColors.find("11") == matchColors.end()));
+    BOOST_TEST((matchColors.find("14") != matchColors.end()));
+
+    // the Once filter stays matched in the next batch
+    FilterMessages(filter, program, matchColors, messages, 7, 8, 107, matches);
+    BOOST_TEST(matches.empty());
+}
+
+BOOST_AUTO_TEST_CASE(FilterStageMatchesInOrder)
+{
+    std::vector<LogFilter> filters(4);
+    filters[0].messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filters[0].messageFilters.emplace_back("error", MatchType::Simple, FilterType::Once);
+    filters[1].messageFilters.emplace_back("noise", MatchType::Simple, FilterType::Exclude);
+    filters[1].messageFilters.emplace_back("stop", MatchType::Simple, FilterType::Stop);
+    filters[2].messageFilters.emplace_back("track", MatchType::Simple, FilterType::Track);
+    filters[2].processFilters.emplace_back("mark", MatchType::Simple, FilterType::Bookmark);
+    filters[3].messageFilters.emplace_back("clear", MatchType::Simple, FilterType::Clear);
+    auto expectedFilters = filters;
+
+    std::vector<std::string> texts;
+    for (size_t i = 0; i < 1000; ++i)
+    {
+        const char* words[] = {"error", "noise", "stop", "track", "clear", "text"};
+        texts.push_back(stringbuilder() << words[i % 6] << " " << i);
+    }
+    std::vector<MessageRef> messages;
+    for (size_t i = 0; i < texts.size(); ++i)
+    {
+        messages.emplace_back(0.0, FILETIME(), 1, i % 7 == 0 ? "marked.exe" : "other.exe", texts[i]);
+    }
+
+    FilterStage stage(3);
+    std::vector<FilterProgram> programs(filters.size());
+    std::vector<MatchColors> matchColors(filters.size());
+    std::vector<std::vector<FilterMatch>> matches(filters.size());
+    stage.Run(filters.size(), [&](size_t i) { FilterMessages(filters[i], programs[i], matchColors[i], messages, 10, messages.size(), 100, matches[i]); });
+
+    for (size_t i = 0; i < filters.size(); ++i)
+    {
+        FilterProgram program;
+        MatchColors colors;
+        std::vector<FilterMatch> expected;
+        FilterMessages(expectedFilters[i], program, colors, messages, 10, messages.size(), 100, expected);
+        BOOST_REQUIRE(matches[i].size() == expected.size());
+        for (size_t j = 0; j < expected.size(); ++j)
+        {
+            BOOST_TEST(matches[i][j].line == expected[j].line);
+            BOOST_TEST(matches[i][j].included == expected[j].included);
+            BOOST_TEST(matches[i][j].clear == expected[j].clear);
+            BOOST_TEST(matches[i][j].bookmark == expected[j].bookmark);
+            BOOST_TEST(matches[i][j].stop == expected[j].stop);
+            BOOST_TEST(matches[i][j].track == expected[j].track);
+            BOOST_TEST(matches[i][j].color == expected[j].color);
+        }
+    }
+
+    // the Once filter adds only the first "error" line, messages[12] is line 102
+    BOOST_REQUIRE(matches[0].size() == 165 + 1);
+    BOOST_TEST(matches[0][0].line == 101);
+    BOOST_TEST(matches[0][1].line == 102);
+    BOOST_TEST(matches[0][2].line == 107);
+    BOOST_TEST(matches[1].size() == 990 - 165);
+    BOOST_TEST(matches[1][3].line == 104);
+    BOOST_TEST(matches[1][3].stop);
+    BOOST_TEST(matches[3][0].clear);
+
+    std::vector<std::atomic<int>> calls(20);
+    for (int run = 0; run < 100; ++run)
+    {
+        stage.Run(calls.size(), [&](size_t i) { ++calls[i]; });
+    }
+    for (auto& count : calls)
+    {
+        BOOST_TEST(count == 100);
+    }
+    BOOST_CHECK_THROW(stage.Run(4, [](size_t i) { if (i == 2) throw std::runtime_error("job"); }), std::runtime_error);
+}
+
+// the color filter CLogView used to look up for an included line
+int FindColorFilter(const LogFilter& filter, std::string_view text, std::string_view processName)
+{
+    auto find = [](const std::vector<Filter>& filters, std::string_view text) {
+        for (auto type : {true, false})
+        {
+            for (size_t i = 0; i < filters.size(); ++i)
+            {
+                auto& f = filters[i];
+                if (f.enable && FilterSupportsColor(f.filterType) && (f.filterType == FilterType::Highlight) == type && IsMatch(f, text))
+                {
+                    return static_cast<int>(i);
+                }
+            }
+        }
+        return -1;
+    };
+
+    auto color = find(filter.messageFilters, text);
+    if (color < 0)
+    {
+        color = find(filter.processFilters, processName);
+        color = color < 0 ? -1 : static_cast<int>(filter.messageFilters.size()) + color;
+    }
+    return color;
+}
+
+BOOST_AUTO_TEST_CASE(FilterProgramMatchesFilters)
+{
+    LogFilter filter;
+    filter.messageFilters.emplace_back("unmatched", MatchType::Simple, FilterType::Exclude);
+    filter.messageFilters.emplace_back("7 ", MatchType::Simple, FilterType::Exclude);
+    filter.messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filter.messageFilters.emplace_back("wor?d", MatchType::Wildcard, FilterType::Include);
+    filter.messageFilters.emplace_back("[0-9]+0 ", MatchType::Regex, FilterType::Once);
+    filter.messageFilters.emplace_back("Lorem", MatchType::RegexCase, FilterType::Highlight);
+    filter.messageFilters.emplace_back("ipsum", MatchType::Simple, FilterType::Track, Colors::Auto);
+    filter.messageFilters.emplace_back("dolor", MatchType::Regex, FilterType::Bookmark);
+    filter.messageFilters.emplace_back("(sit|amet)", MatchType::Regex, FilterType::Stop);
+    filter.messageFilters.emplace_back("9", MatchType::Simple, FilterType::Beep);
+    filter.messageFilters.emplace_back("3", MatchType::Simple, FilterType::Clear, Colors::BackGround, Colors::Text, false);
+    filter.messageFilters.emplace_back("\\d\\d", MatchType::Regex, FilterType::Token, Colors::Auto);
+    filter.processFilters.emplace_back("marked", MatchType::Simple, FilterType::Highlight);
+    filter.processFilters.emplace_back("skip", MatchType::Simple, FilterType::Exclude);
+    filter.processFilters.emplace_back("5", MatchType::Simple, FilterType::Beep);
+    auto expectedFilter = filter;
+
+    FilterProgram program;
+    program.Update(filter);
+    MatchColors matchColors;
+    MatchColors expectedColors;
+    const char* processNames[] = {"marked.exe", "skip.exe", "other.exe"};
+    int included = 0;
+    const char* words[] = {"text", "world", "Lorem", "lorem ipsum", "dolor sit", "amet", "noise"};
+    for (int i = 0; i < 5000; ++i)
+    {
+        std::string text = stringbuilder() << words[i % 7] << " " << words[i / 7 % 7] << " " << i << " ";
+        std::string_view processName = processNames[i % 3];
+        auto result = program.Run(filter, text, processName, matchColors);
+
+        bool expected = IsIncluded(expectedFilter.processFilters, processName, expectedColors) && IsIncluded(expectedFilter.messageFilters, text, expectedColors);
+        BOOST_REQUIRE(((result.flags & FilterResult::Include) != 0) == expected);
+        BOOST_TEST(((result.flags & FilterResult::Clear) != 0) == MatchFilterType(expectedFilter.messageFilters, FilterType::Clear, text));
+        if (!expected)
+        {
+            continue;
+        }
+
+        ++included;
+        auto matchType = [&](FilterType::type type) {
+            return MatchFilterType(expectedFilter.messageFilters, type, text) || MatchFilterType(expectedFilter.processFilters, type, processName);
+        };
+        BOOST_TEST(((result.flags & FilterResult::Beep) != 0) == (MatchFilterType(expectedFilter.messageFilters, FilterType::Beep, text) || MatchFilterType(expectedFilter.processFilters, FilterType::Beep, text)));
+        BOOST_TEST(((result.flags & FilterResult::Bookmark) != 0) == matchType(FilterType::Bookmark));
+        BOOST_TEST(((result.flags & FilterResult::Stop) != 0) == matchType(FilterType::Stop));
+        BOOST_TEST(((result.flags & FilterResult::Track) != 0) == matchType(FilterType::Track));
+        BOOST_TEST(result.color == FindColorFilter(expectedFilter, text, processName));
+    }
+    BOOST_TEST(included > 0);
+    BOOST_TEST(matchColors.size() == expectedColors.size());
+
+    // a changed filter rebuilds the program
+    filter.messageFilters[1].enable = false;
+    program.Update(filter);
+    auto result = program.Run(filter, "text 17 ", "other.exe", matchColors, FilterResult::Include);
+    BOOST_TEST((result.flags & FilterResult::Include) != 0);
+}
+
+BOOST_AUTO_TEST_CASE(FilterScanMatchesFilteringInOrder)
+{
+    LogFilter filter;
+    filter.messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filter.messageFilters.emplace_back("9[0-9]5 ", MatchType::Regex, FilterType::Once);
+    filter.messageFilters.emplace_back("noise", MatchType::Simple, FilterType::Exclude);
+    filter.messageFilters.emplace_back("\\d\\d", MatchType::Regex, FilterType::Token, Colors::Auto);
+    filter.processFilters.emplace_back("alpha", MatchType::Simple, FilterType::Include);
+    filter.processFilters.emplace_back("beta", MatchType::Simple, FilterType::Once);
+
+    // line 905 is the first "beta" line of its chunk, so it matches both Once filters in the chunk.
+    // In order "beta" was matched before, so the message filters of line 905 are not evaluated
+    const char* words[] = {"text", "world", "noise", "lorem"};
+    const char* processNames[] = {"alpha.exe", "beta.exe", "gamma.exe"};
+    LogFile logFile;
+    auto addLines = [&](int count) {
+        for (int i = 0; i < count; ++i)
+        {
+            int line = logFile.EndIndex();
+            std::string text = stringbuilder() << words[line % 4] << " " << words[line / 4 % 2] << " " << line << " ";
+            logFile.Add(Message(line, FILETIME(), 1, processNames[line / 5 % 3], text));
+        }
+    };
+    addLines(3000);
+
+    // lines added while the scan runs are scanned as well
+    FilterStage stage(3);
+    auto scanFilter = filter;
+    FilterProgram program;
+    MatchColors matchColors;
+    std::vector<FilterMatch> matches;
+    FilterScan scan(logFile, scanFilter, LineQuery(), 0, stage.GetThreadCount() + 1, 50);
+    for (int step = 0; scan.Step(stage, scanFilter, program, matchColors, matches); ++step)
+    {
+        if (step == 2)
+        {
+            addLines(500);
+        }
+    }
+    BOOST_TEST(scan.GetLine() == 3500);
+
+    FilterProgram expectedProgram;
+    expectedProgram.Update(filter);
+    MatchColors expectedColors;
+    std::vector<FilterMatch> expected;
+    for (int line = 0; line < logFile.EndIndex(); ++line)
+    {
+        auto msg = logFile.GetMessageRef(line);
+        auto result = expectedProgram.Run(filter, msg.text, msg.processName, expectedColors, FilterResult::Include | FilterResult::Color);
+        if (result.flags & FilterResult::Include)
+        {
+            expected.push_back(FilterMatch{line, false, true, false, false, false, false, result.color});
+        }
+    }
+
+    BOOST_REQUIRE(matches.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        BOOST_TEST(matches[i].line == expected[i].line);
+        BOOST_TEST(matches[i].color == expected[i].color);
+    }
+    BOOST_TEST(scanFilter.messageFilters[1].matched == filter.messageFilters[1].matched);
+    BOOST_TEST(scanFilter.processFilters[1].matched == filter.processFilters[1].matched);
+    for (auto& color : expectedColors)
+    {
+        BOOST_TEST(matchColors.count(color.first) == 1u);
+    }
+}
+
+// the lines that are added during a scan were not filtered live, the scan reports all their actions
+BOOST_AUTO_TEST_CASE(FilterScanReportsActionsOfAddedLines)
+{
+    LogFilter filter;
+    filter.messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filter.messageFilters.emplace_back("reset", MatchType::Simple, FilterType::Clear);
+    filter.messageFilters.emplace_back("beep", MatchType::Simple, FilterType::Beep);
+
+    LogFile logFile;
+    auto addLines = [&](int count) {
+        for (int i = 0; i < count; ++i)
+        {
+            int line = logFile.EndIndex();
+            std::string text = stringbuilder() << "text " << line << (line % 10 == 0 ? " beep" : "");
+            if (line == 1500)
+            {
+                text = "reset";
+            }
+            logFile.Add(Message(line, FILETIME(), 1, "test.exe", text));
+        }
+    };
+    addLines(1000);
+
+    FilterStage stage(3);
+    FilterProgram program;
+    MatchColors matchColors;
+    std::vector<FilterMatch> matches;
+    FilterScan scan(logFile, filter, GetFilterQuery(filter), 0, stage.GetThreadCount() + 1, 100);
+    for (int step = 0; scan.Step(stage, filter, program, matchColors, matches); ++step)
+    {
+        if (step == 0)
+        {
+            addLines(1000);
+        }
+    }
+
+    BOOST_REQUIRE(matches.size() == 2000u);
+    for (auto& match : matches)
+    {
+        BOOST_TEST(match.included == (match.line != 1500));
+        BOOST_TEST(match.clear == (match.line == 1500));
+        BOOST_TEST(match.beep == (match.line >= 1000 && match.line != 1500 && match.line % 10 == 0));
+    }
+}
+
+// the scan of lines added after it started gives the results of filtering them one by one, across Clear lines
+BOOST_AUTO_TEST_CASE(FilterScanClearResetsOnceFilters)
+{
+    LogFilter filter;
+    filter.messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filter.messageFilters.emplace_back("error", MatchType::Simple, FilterType::Once);
+    filter.messageFilters.emplace_back("clear", MatchType::Simple, FilterType::Clear);
+    filter.messageFilters.emplace_back("\\d\\d", MatchType::Regex, FilterType::Token, Colors::Auto);
+
+    LogFile logFile;
+    std::vector<std::string> texts;
+    for (int line = 0; line < 2000; ++line)
+    {
+        const char* words[] = {"text", "error", "lorem"};
+        texts.push_back(stringbuilder() << (line % 170 == 169 ? "clear" : words[line * 7 % 3]) << " " << line % 97);
+    }
+
+    FilterStage stage(3);
+    auto scanFilter = filter;
+    FilterProgram program;
+    MatchColors matchColors;
+    std::vector<FilterMatch> matches;
+    FilterScan scan(logFile, scanFilter, LineQuery(), 0, stage.GetThreadCount() + 1, 50);
+    for (auto& text : texts)
+    {
+        logFile.Add(Message(0.0, FILETIME(), 1, "test.exe", text));
+    }
+    while (scan.Step(stage, scanFilter, program, matchColors, matches))
+    {
+    }
+
+    std::vector<MessageRef> messages;
+    for (auto& text : texts)
+    {
+        messages.emplace_back(0.0, FILETIME(), 1, "test.exe", text);
+    }
+    FilterProgram expectedProgram;
+    MatchColors expectedColors;
+    std::vector<FilterMatch> expected;
+    FilterMessages(filter, expectedProgram, expectedColors, messages, 0, messages.size(), 0, expected);
+
+    BOOST_REQUIRE(matches.size() == expected.size());
+    for (size_t i = 0; i < expected.size(); ++i)
+    {
+        BOOST_TEST(matches[i].line == expected[i].line);
+        BOOST_TEST(matches[i].included == expected[i].included);
+        BOOST_TEST(matches[i].clear == expected[i].clear);
+    }
+    BOOST_TEST(scanFilter.messageFilters[1].matched == filter.messageFilters[1].matched);
+    BOOST_TEST(matchColors.size() == expectedColors.size());
+    for (auto& color : expectedColors)
+    {
+        BOOST_TEST((matchColors.find(color.first) != matchColors.end()));
+    }
+}
+
+std::vector<FilterMatch> FilterLinesInOrder(const LogFile& logFile, LogFilter filter)
+{
+    FilterProgram program;
+    program.Update(filter);
+    MatchColors matchColors;
+    std::vector<FilterMatch> matches;
+    for (int line = logFile.BeginIndex(); line < logFile.EndIndex(); ++line)
+    {
+        auto msg = logFile.GetMessageRef(line);
+        auto result = program.Run(filter, msg.text, msg.processName, matchColors, FilterResult::Include | FilterResult::Color);
+        if (result.flags & FilterResult::Include)
+        {
+            matches.push_back(FilterMatch{line, false, true, false, false, false, false, result.color});
+        }
+    }
+    return matches;
+}
+
+BOOST_AUTO_TEST_CASE(FilterScanRefiltersEditedLines)
+{
+    LogFilter filter;
+    filter.messageFilters.emplace_back("text", MatchType::Simple, FilterType::Include);
+    filter.messageFilters.emplace_back("noise", MatchType::Simple, FilterType::Exclude);
+    filter.processFilters.emplace_back("alpha", MatchType::Simple, FilterType::Include);
+
+    auto narrowed = filter;
+    narrowed.messageFilters.emplace_back("lorem", MatchType::Simple, FilterType::Exclude);
+    auto noExclude = filter;
+    noExclude.messageFilters[1].enable = false;
+    auto moreMessages = filter;
+    moreMessages.messageFilters.emplace_back("world", MatchType::Simple, FilterType::Include);
+    auto moreProcesses = filter;
+    moreProcesses.processFilters.emplace_back("beta", MatchType::Simple, FilterType::Include);
+    auto highlighted = filter;
+    highlighted.messageFilters.emplace_back("1", MatchType::Simple, FilterType::Highlight);
+    auto highlightedWider = noExclude;
+    highlightedWider.messageFilters.emplace_back("1", MatchType::Simple, FilterType::Highlight);
+    auto once = filter;
+    once.messageFilters.emplace_back("5", MatchType::Simple, FilterType::Once);
+
+    BOOST_TEST(ClassifyFilterEdit(filter, filter) == FilterEdit::Narrowing);
+    BOOST_TEST(ClassifyFilterEdit(filter, narrowed) == FilterEdit::Narrowing);
+    BOOST_TEST(ClassifyFilterEdit(filter, highlighted) == FilterEdit::Narrowing);
+    BOOST_TEST(ClassifyFilterEdit(filter, noExclude) == FilterEdit::Widening);
+    BOOST_TEST(ClassifyFilterEdit(filter, moreMessages) == FilterEdit::Widening);
+    BOOST_TEST(ClassifyFilterEdit(filter, moreProcesses) == FilterEdit::Widening);
+    BOOST_TEST(ClassifyFilterEdit(moreMessages, filter) == FilterEdit::Narrowing);
+    BOOST_TEST(ClassifyFilterEdit(filter, highlightedWider) == FilterEdit::Arbitrary);
+    BOOST_TEST(ClassifyFilterEdit(filter, once) == FilterEdit::Arbitrary);
+
+    const char* words[] = {"text", "world", "noise", "lorem"};
+    const char* processNames[] = {"alpha.exe", "beta.exe", "gamma.exe"};
+    LogFile logFile;
+    auto addLines = [&](int count) {
+        for (int i = 0; i < count; ++i)
+        {
+            int line = logFile.EndIndex();
+            std::string text = stringbuilder() << words[line % 4] << " " << words[line / 4 % 3] << " " << line;
+            logFile.Add(Message(line, FILETIME(), 1, processNames[line / 5 % 3], text));
+        }
+    };
+    addLines(2000);
+    auto included = FilterLinesInOrder(logFile, filter);
+    int endLine = logFile.EndIndex();
+
+    // the edit is scanned like CLogView::ApplyFilters() does, with lines added while it runs
+    FilterStage stage(3);
+    for (auto& edited : {narrowed, highlighted, noExclude, moreMessages, moreProcesses})
+    {
+        auto scanFilter = edited;
+        FilterProgram program;
+        MatchColors matchColors;
+        std::vector<FilterMatch> matches;
+        FilterScan scan(logFile, scanFilter, LineQuery(), 0, stage.GetThreadCount() + 1, 50);
+        if (ClassifyFilterEdit(filter, edited) == FilterEdit::Narrowing)
+        {
+            std::vector<int> lines;
+            for (auto& match : included)
+            {
+                lines.push_back(match.line);
+            }
+            scan.SetCandidates(lines, endLine);
+        }
+        else
+        {
+            std::vector<FilterMatch> kept;
+            for (auto& match : included)
+            {
+                if (KeepsColor(filter, edited, match.color))
+                {
+                    kept.push_back(match);
+                }
+            }
+            scan.SetIncluded(kept, endLine);
+        }
+
+        for (int step = 0; scan.Step(stage, scanFilter, program, matchColors, matches); ++step)
+        {
+            if (step == 1)
+            {
+                addLines(100);
+            }
+        }
+
+        auto expected = FilterLinesInOrder(logFile, edited);
+        BOOST_REQUIRE(matches.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            BOOST_TEST(matches[i].line == expected[i].line);
+            BOOST_TEST(matches[i].color == expected[i].color);
+        }
+    }
+}
+
+// a Once filter adds its first match to the lines that pass the Include filters, without Include filters it restricts nothing
+BOOST_AUTO_TEST_CASE(FilterScanQueriesOnlyIncludeFilters)
+{
+    LogFilter once;
+    once.messageFilters.emplace_back("marker", MatchType::Simple, FilterType::Once);
+    once.messageFilters.emplace_back("noise", MatchType::Simple, FilterType::Exclude);
+    once.processFilters.emplace_back("beta", MatchType::Simple, FilterType::Once);
+    auto included = once;
+    included.messageFilters.emplace_back("line", MatchType::Simple, FilterType::Include);
+
+    auto query = GetFilterQuery(once);
+    BOOST_TEST(query.textAnyOf.empty());
+    BOOST_TEST(!query.processFilter);
+    query = GetFilterQuery(included);
+    BOOST_TEST(query.textAnyOf.size() == 2u);
+
+    LogFile logFile;
+    for (int line = 0; line < 12000; ++line)
+    {
+        std::string text = stringbuilder() << (line % 3 == 0 ? "noise " : "line ") << line << (line == 5000 ? " marker" : "");
+        logFile.Add(Message(line, FILETIME(), 1, line < 8192 ? "alpha.exe" : "beta.exe", text));
+    }
+
+    FilterStage stage(3);
+    for (auto& filter : {once, included})
+    {
+        auto scanFilter = filter;
+        FilterProgram program;
+        MatchColors matchColors;
+        std::vector<FilterMatch> matches;
+        FilterScan scan(logFile, scanFilter, GetFilterQuery(filter), 0, stage.GetThreadCount() + 1);
+        while (scan.Step(stage, scanFilter, program, matchColors, matches))
+        {
+        }
+
+        auto expected = FilterLinesInOrder(logFile, filter);
+        BOOST_TEST(expected.size() == 8000u);
+        BOOST_REQUIRE(matches.size() == expected.size());
+        for (size_t i = 0; i < expected.size(); ++i)
+        {
+            BOOST_TEST(matches[i].line == expected[i].line);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(LineBufferContention)
+{
+    const size_t producers = 4;
+    const size_t linesPerProducer = 10000;
+
+    bool ordered = false;
+    VectorLineBuffer vectorBuffer(16 * 1024);
+    RunLineBufferProducers(vectorBuffer, producers, linesPerProducer, ordered);
+    BOOST_TEST(ordered);
+    BOOST_TEST(vectorBuffer.Empty());
+
+    RingLineBuffer ringBuffer(16 * 1024);
+    RunLineBufferProducers(ringBuffer, producers, linesPerProducer, ordered);
+    BOOST_TEST(ordered);
+    BOOST_TEST(ringBuffer.Empty());
+
+    // a small ring overflows all the time, lines must still arrive complete and in order
+    RingLineBuffer smallBuffer(16);
+    RunLineBufferProducers(smallBuffer, producers, linesPerProducer, ordered);
+    BOOST_TEST(ordered);
+    BOOST_TEST(smallBuffer.Empty());
+}
+
+class BlockingTestSource : public TestSource
+{
+public:
+    using TestSource::TestSource;
+
+    bool AllowsBlocking() const override
+    {
+        return true;
+    }
+};
+
+BOOST_AUTO_TEST_CASE(RingLineBufferIngestBudget)
+{
+    Timer timer;
+    FILETIME ft = {};
+    IngestBudget budget;
+    budget.maxLines = 100;
+
+    // the newest lines are dropped, the marker follows the lines that were kept
+    budget.policy = IngestPolicy::DropNewest;
+    RingLineBuffer newestBuffer(16, budget);
+    TestSource newestSource(timer, newestBuffer);
+    for (size_t i = 0; i < 300; ++i)
+    {
+        newestBuffer.Add(0.0, ft, 1, "test", GetTestString(i), &newestSource);
+    }
+    auto lines = newestBuffer.GetLines();
+    BOOST_TEST(lines.size() == 101);
+    BOOST_TEST(lines[99].message == GetTestString(99));
+    BOOST_TEST(lines[100].message == "200 lines dropped");
+    BOOST_TEST(newestSource.GetDroppedLines() == 200);
+    BOOST_TEST(newestBuffer.GetDroppedLines() == 200);
+    BOOST_TEST(newestBuffer.Empty());
+
+    // the oldest lines of the overflow list are dropped, lines in the ring are kept
+    budget.policy = IngestPolicy::DropOldest;
+    RingLineBuffer oldestBuffer(16, budget);
+    TestSource oldestSource(timer, oldestBuffer);
+    for (size_t i = 0; i < 300; ++i)
+    {
+        oldestBuffer.Add(0.0, ft, 1, "test", GetTestString(i), &oldestSource);
+    }
+    lines = oldestBuffer.GetLines();
+    BOOST_TEST(lines.size() == 101);
+    BOOST_TEST(lines[15].message == GetTestString(15));
+    BOOST_TEST(lines[16].message == "200 lines dropped");
+    BOOST_TEST(lines[17].message == GetTestString(216));
+    BOOST_TEST(lines[100].message == GetTestString(299));
+    BOOST_TEST(oldestSource.GetDroppedLines() == 200);
+
+    // a line with a process handle is kept, only the producer's own source counts its dropped lines
+    RingLineBuffer handleBuffer(16, budget);
+    TestSource handleSource(timer, handleBuffer);
+    TestSource otherSource(timer, handleBuffer);
+    auto handle = reinterpret_cast<HANDLE>(1);
+    for (size_t i = 0; i < 100; ++i)
+    {
+        if (i == 20)
+        {
+            handleBuffer.Add(0.0, ft, handle, GetTestString(i), &handleSource);
+        }
+        else
+        {
+            handleBuffer.Add(0.0, ft, 1, "test", GetTestString(i), &handleSource);
+        }
+    }
+    for (size_t i = 0; i < 100; ++i)
+    {
+        handleBuffer.Add(0.0, ft, 2, "other", GetTestString(i), &otherSource);
+    }
+    lines = handleBuffer.GetLines();
+    BOOST_TEST(lines.size() == 102);
+    BOOST_TEST(lines[16].message == "4 lines dropped");
+    BOOST_TEST(lines[17].handle == handle);
+    BOOST_TEST(lines[18].message == "96 lines dropped");
+    BOOST_TEST(lines[19].message == GetTestString(17));
+    BOOST_TEST(handleSource.GetDroppedLines() == 0);
+    BOOST_TEST(otherSource.GetDroppedLines() == 17);
+    BOOST_TEST(handleBuffer.GetDroppedLines() == 100);
+
+    // a source that allows blocking waits for the consumer, nothing is lost
+    budget.policy = IngestPolicy::Block;
+    RingLineBuffer blockBuffer(16, budget);
+    BlockingTestSource blockSource(timer, blockBuffer);
+    std::thread producer([&] {
+        for (size_t i = 0; i < 10000; ++i)
+        {
+            blockBuffer.Add(static_cast<double>(i), ft, 1, "test", GetTestString(i), &blockSource);
+        }
+    });
+    size_t received = 0;
+    bool ordered = true;
+    while (received < 10000)
+    {
+        for (auto& line : blockBuffer.GetLines())
+        {
+            ordered = ordered && line.message == GetTestString(received);
+            ++received;
+        }
+    }
+    producer.join();
+    BOOST_TEST(ordered);
+    BOOST_TEST(blockBuffer.GetDroppedLines() == 0);
+
+    // a budget of 0 is unlimited
+    budget.maxLines = 0;
+    budget.maxBytes = 0;
+    budget.policy = IngestPolicy::DropNewest;
+    RingLineBuffer unlimitedBuffer(16, budget);
+    TestSource unlimitedSource(timer, unlimitedBuffer);
+    for (size_t i = 0; i < 300; ++i)
+    {
+        unlimitedBuffer.Add(0.0, ft, 1, "test", GetTestString(i), &unlimitedSource);
+    }
+    BOOST_TEST(unlimitedBuffer.GetLines().size() == 300);
+    BOOST_TEST(unlimitedBuffer.GetDroppedLines() == 0);
+}
+
 BOOST_AUTO_TEST_CASE(IndexedStorageRandomAccess)
 {
     using namespace indexedstorage;
@@ -333,6 +1348,268 @@ BOOST_AUTO_TEST_CASE(IndexedStorageRandomAccess)
     BOOST_TEST(!failed);
 }
 
+BOOST_AUTO_TEST_CASE(IndexedStoragePrefetch)
+{
+    using namespace indexedstorage;
+
+    size_t testSize = 10000;
+    SnappyStorage s;
+    s.SetCacheSize(64 * 1024); // a few blocks only, forces evictions
+    for (size_t i = 0; i < testSize; ++i)
+        s.Add(GetTestString(i));
+
+    bool failed = false;
+    for (size_t i = 0; i < testSize; i += 50)
+    {
+        s.Prefetch(i, i + 100);
+        if (s[i] != GetTestString(i))
+        {
+            failed = true;
+            break;
+        }
+    }
+    BOOST_TEST(!failed);
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageView)
+{
+    using namespace indexedstorage;
+
+    size_t testSize = 10000;
+    SnappyStorage s;
+    s.SetCacheSize(0); // only the most recently used block is cached
+    for (size_t i = 0; i < testSize; ++i)
+        s.Add(GetTestString(i));
+
+    bool failed = false;
+    for (size_t i = 0; i < testSize; i += 7)
+    {
+        if (s.View(i) != GetTestString(i) || s.View(testSize - 1 - i) != GetTestString(testSize - 1 - i))
+        {
+            failed = true;
+            break;
+        }
+    }
+    BOOST_TEST(!failed);
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageSpill)
+{
+    using namespace indexedstorage;
+
+    size_t testSize = 100000;
+    size_t budget = 64 * 1024;
+    SnappyStorage s;
+    s.SetMemoryBudget(budget);
+    s.SetCacheSize(0);
+    for (size_t i = 0; i < testSize; ++i)
+        s.Add(GetTestString(i));
+    s.Flush();
+
+    BOOST_TEST(s.GetSpilledSize() > 0);
+    BOOST_TEST(s.GetStorageSize() <= budget);
+
+    std::mt19937 generator;
+    std::uniform_int_distribution<size_t> distribution(0, testSize - 1);
+    bool failed = false;
+    for (size_t i = 0; i < testSize / 10; ++i)
+    {
+        size_t j = distribution(generator);
+        if (i % 100 == 0)
+            s.Prefetch(j, j + 1000);
+        if (s.View(j) != GetTestString(j))
+        {
+            failed = true;
+            break;
+        }
+    }
+    BOOST_TEST(!failed);
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageBlockLimits)
+{
+    using namespace indexedstorage;
+
+    size_t testSize = 5000;
+    SnappyStorage s;
+    s.SetBlockLimits(32 * 1024, 16, 4096);
+    s.SetCacheSize(0);
+    for (size_t i = 0; i < testSize; ++i)
+        s.Add(GetMixedTestString(i));
+    s.Flush();
+
+    BOOST_TEST(s.Count() == testSize);
+    bool failed = false;
+    for (size_t i = 0; i < testSize; ++i)
+    {
+        if (s.View(i) != GetMixedTestString(i))
+        {
+            failed = true;
+            break;
+        }
+    }
+    BOOST_TEST(!failed);
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageSynopsis)
+{
+    using namespace indexedstorage;
+
+    SnappyStorage s;
+    s.SetBlockLimits(0, 100, 100);
+    for (int i = 0; i < 1000; ++i)
+        s.Add(std::string(i < 500 ? "Alpha message " : "beta message ") + std::to_string(i));
+    s.Flush();
+
+    BOOST_TEST(s.GetBlockEnd(0) == 100u);
+    BOOST_TEST(s.GetBlockEnd(150) == 200u);
+    BOOST_TEST(s.MayContain(0, "ALPHA"));
+    BOOST_TEST(!s.MayContain(0, "beta"));
+    BOOST_TEST(s.MayContain(999, "Beta"));
+    BOOST_TEST(!s.MayContain(999, "alpha"));
+    BOOST_TEST(s.MayContain(0, "xy")); // too short to decide
+
+    // the write block has no synopsis
+    s.Add("gamma");
+    BOOST_TEST(s.GetBlockEnd(1000) == 1001u);
+    BOOST_TEST(s.MayContain(1000, "alpha"));
+}
+
+BOOST_AUTO_TEST_CASE(IndexedStorageSynopsisHighEntropy)
+{
+    using namespace indexedstorage;
+
+    // random lines have too many distinct trigrams for the filter size, the block is not filtered
+    SnappyStorage s;
+    s.SetBlockLimits(0, 100, 100);
+    std::mt19937 generator;
+    std::uniform_int_distribution<int> distribution('a', 'z');
+    for (int i = 0; i < 200; ++i)
+    {
+        std::string line;
+        for (int j = 0; j < 40; ++j)
+            line += static_cast<char>(distribution(generator));
+        s.Add(line);
+    }
+    s.Flush();
+
+    BOOST_TEST(s.MayContain(0, "0123456789"));
+    BOOST_TEST(s.MayContain(199, "0123456789"));
+}
+
+BOOST_AUTO_TEST_CASE(TemplateStorageRoundTrip)
+{
+    using namespace indexedstorage;
+
+    size_t testSize = 10000;
+    TemplateStorage s;
+    s.Add("");
+    for (size_t i = 1; i < testSize; ++i)
+        s.Add(GetTemplateTestString(i));
+
+    BOOST_TEST(s[0].empty());
+    bool failed = false;
+    for (size_t i = 1; i < testSize; ++i)
+    {
+        if (s.View(i) != GetTemplateTestString(i))
+        {
+            failed = true;
+            break;
+        }
+    }
+    BOOST_TEST(!failed);
+    BOOST_TEST(s.GetTemplateCount() < 10);
+}
+
+BOOST_AUTO_TEST_CASE(LogFileHistorySize)
+{
+    int historySize = 1000;
+    int testSize = 20000;
+    const int maxBlockLines = 4096; // SnappyStorage seals a block at this many lines at the latest
+    LogFile logFile;
+    logFile.SetHistorySize(historySize);
+    auto systemTime = Win32::GetSystemTimeAsFileTime();
+    for (int i = 0; i < testSize; ++i)
+        logFile.Add(Message(0, systemTime, 0, "processname", GetTestString(i)));
+
+    // lines are dropped a storage block at a time, so the history holds at least historySize lines
+    // and less than a block more
+    BOOST_TEST(logFile.Count() >= historySize);
+    BOOST_TEST(logFile.Count() < historySize + maxBlockLines);
+    BOOST_TEST(logFile.BeginIndex() > 0);
+    BOOST_TEST(logFile.EndIndex() == testSize);
+    BOOST_TEST(logFile[logFile.BeginIndex()].text == GetTestString(logFile.BeginIndex()));
+    BOOST_TEST(logFile[logFile.EndIndex() - 1].text == GetTestString(testSize - 1));
+}
+
+BOOST_AUTO_TEST_CASE(LogFileSynopsis)
+{
+    int testSize = 4096;
+    LogFile logFile;
+    auto systemTime = Win32::GetSystemTimeAsFileTime();
+    for (int i = 0; i < testSize; ++i)
+        logFile.Add(Message(i, systemTime, i < 2048 ? 1 : 2, i < 2048 ? "first" : "second", GetTestString(i)));
+
+    LineQuery query;
+    BOOST_TEST(logFile.NextCandidates(0, query).begin == 0);
+
+    query.processFilter = [](std::string_view processName) { return processName == "second"; };
+    BOOST_TEST(!logFile.MayMatch(0, query));
+    BOOST_TEST(logFile.MayMatch(2048, query));
+    BOOST_TEST(logFile.NextCandidates(0, query).begin == 2048);
+
+    query = LineQuery();
+    query.beginTime = 3000;
+    BOOST_TEST(logFile.NextCandidates(0, query).begin == 2048);
+    query.beginTime = 5000;
+    BOOST_TEST(logFile.NextCandidates(0, query).begin == testSize);
+}
+
+BOOST_AUTO_TEST_CASE(LogFileLowerBoundByTime)
+{
+    int testSize = 5000;
+    LogFile logFile;
+    FILETIME systemTime;
+    systemTime.dwHighDateTime = 30000000;
+    for (int i = 0; i < testSize; ++i)
+    {
+        systemTime.dwLowDateTime = i;
+        logFile.Add(Message(i * 0.5, systemTime, 0, "processname", GetTestString(i)));
+    }
+
+    BOOST_TEST(logFile[1234].time == 617.0);
+    BOOST_TEST(logFile[4999].text == GetTestString(4999));
+    BOOST_TEST(logFile.LowerBoundByTime(-1.0) == 0);
+    BOOST_TEST(logFile.LowerBoundByTime(617.0) == 1234);
+    BOOST_TEST(logFile.LowerBoundByTime(617.1) == 1235);
+    BOOST_TEST(logFile.LowerBoundByTime(1e6) == testSize);
+
+    systemTime.dwLowDateTime = 3000;
+    BOOST_TEST(logFile.LowerBoundBySystemTime(systemTime) == 3000);
+    BOOST_TEST(logFile[3000].systemTime.dwLowDateTime == 3000u);
+}
+
+BOOST_AUTO_TEST_CASE(ProcessInfoPidReuse)
+{
+    ProcessInfo processInfo;
+    auto uid = processInfo.GetUid(10, "app.exe");
+    BOOST_TEST(processInfo.GetUid(10, "app.exe") == uid);
+    BOOST_TEST(processInfo.GetUid(10, "other.exe") != uid);
+    BOOST_TEST(processInfo.GetUid(11, "app.exe") != uid);
+
+    // an unknown start time is completed by the first known start time
+    BOOST_TEST(processInfo.GetUid(10, "app.exe", 1000) == uid);
+    auto reusedUid = processInfo.GetUid(10, "app.exe", 2000);
+    BOOST_TEST(reusedUid != uid);
+    BOOST_TEST(processInfo.GetUid(10, "app.exe") == reusedUid);
+    BOOST_TEST(processInfo.GetProcessPropertiesRef(uid).pid == 10u);
+
+    processInfo.Compact({reusedUid});
+    BOOST_TEST(processInfo.Count() == 1u);
+    BOOST_TEST(processInfo.GetUid(10, "app.exe", 2000) == reusedUid);
+    BOOST_TEST(processInfo.GetUid(11, "app.exe") > reusedUid);
+}
+
 BOOST_AUTO_TEST_CASE(IndexedStorageCompression)
 {
     using namespace indexedstorage;
@@ -358,6 +1635,7 @@ BOOST_AUTO_TEST_CASE(IndexedStorageCompression)
 
     for (size_t i = 0; i < testSize; ++i)
         s.Add(GetTestString(i));
+    s.Flush(); // blocks are compressed in the background
 
     size_t m2 = ProcessInfo::GetPrivateBytes();
     size_t usedBySnappy = m2 - m1;
@@ -468,6 +1746,73 @@ std::wstring GetExecutePath()
     return path.remove_filename().c_str();
 }
 
+// more sources than one WaitForMultipleObjects call can handle, each source must keep its lines in order
+BOOST_AUTO_TEST_CASE(LogSourcesManyPipes)
+{
+    using namespace std::chrono_literals;
+    const size_t pipeCount = 150;
+    const size_t linesPerPipe = 100;
+
+    std::vector<Win32::Handle> readEnds;
+    std::vector<Win32::Handle> writeEnds;
+    for (size_t i = 0; i < pipeCount; ++i)
+    {
+        HANDLE hRead;
+        HANDLE hWrite;
+        BOOST_REQUIRE(CreatePipe(&hRead, &hWrite, nullptr, 0));
+        readEnds.emplace_back(hRead);
+        writeEnds.emplace_back(hWrite);
+    }
+
+    ActiveExecutorClient executor;
+    LogSources logsources(executor, true);
+    executor.Call([&] {
+        for (size_t i = 0; i < pipeCount; ++i)
+        {
+            logsources.AddPipeReader(static_cast<DWORD>(i + 1), readEnds[i].get());
+        }
+    });
+
+    for (auto& hWrite : writeEnds)
+    {
+        std::string text;
+        for (size_t i = 0; i < linesPerPipe; ++i)
+        {
+            text += GetTestString(i) + "\n";
+        }
+        DWORD written = 0;
+        BOOST_REQUIRE(WriteFile(hWrite.get(), text.data(), static_cast<DWORD>(text.size()), &written, nullptr));
+    }
+
+    Timer timer;
+    bool ordered = true;
+    std::vector<size_t> next(pipeCount + 1, 0);
+    size_t received = 0;
+    while (received < pipeCount * linesPerPipe && timer.Get() < 10.0)
+    {
+        Lines lines;
+        executor.Call([&] { lines = logsources.GetLines(); });
+        for (auto& line : lines)
+        {
+            if (line.pid == 0 || line.pid > pipeCount)
+            {
+                continue;
+            }
+            auto& expected = next[line.pid];
+            if (line.message != GetTestString(expected))
+            {
+                ordered = false;
+            }
+            ++expected;
+            ++received;
+        }
+        std::this_thread::sleep_for(10ms);
+    }
+    BOOST_TEST(received == pipeCount * linesPerPipe);
+    BOOST_TEST(ordered);
+    executor.Call([&] { logsources.Abort(); });
+}
+
 BOOST_AUTO_TEST_CASE(LogSourceLoopback)
 {
     using namespace std::chrono_literals;
@@ -520,6 +1865,42 @@ BOOST_AUTO_TEST_CASE(LogSourceDBWinReader)
     BOOST_TEST(lines.size() == 1);
 }
 
+// without Notify() the capture ring fills up, the capture thread then counts the wait for a free slot as a stall
+BOOST_AUTO_TEST_CASE(DBWinReaderRingFull)
+{
+    using namespace std::chrono_literals;
+
+    Timer timer;
+    VectorLineBuffer buffer(16 * 1024);
+    DBWinReader reader(timer, buffer, false);
+    const size_t messages = 200;
+    std::thread writer([] {
+        for (size_t i = 0; i < messages; ++i)
+        {
+            ::OutputDebugStringA(GetTestString(i).c_str());
+        }
+    });
+
+    for (int i = 0; i < 100 && reader.GetRingFullCount() == 0; ++i)
+    {
+        std::this_thread::sleep_for(10ms);
+    }
+    BOOST_TEST(reader.GetRingFullCount() == 1u);
+
+    std::this_thread::sleep_for(50ms);
+    size_t received = 0;
+    for (int i = 0; i < 100 && received < messages; ++i)
+    {
+        reader.Notify();
+        received += buffer.GetLines().size();
+        std::this_thread::sleep_for(10ms);
+    }
+    writer.join();
+    BOOST_TEST(received >= messages);
+    BOOST_TEST(reader.GetRingFullCount() >= 1u);
+    BOOST_TEST(reader.GetStallTime() >= 0.04);
+}
+
 std::string CreateTestFile()
 {
     Timer timer;
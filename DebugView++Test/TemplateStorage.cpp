@@ -0,0 +1,349 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#include "stdafx.h"
+#include <limits>
+#include <algorithm>
+#include "TemplateStorage.h"
+#include "IndexedStorageLib/Varint.h"
+#include "snappy.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+const size_t blockLines = 1024;
+const size_t maxTemplates = 64 * 1024;
+const size_t maxFieldDigits = 19; // any 19 digit number fits in an uint64_t
+const char fieldMarker = '\1';
+const size_t noBlock = std::numeric_limits<size_t>::max();
+
+bool IsDigit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+TemplateStorage::TemplateStorage() :
+    m_templateBytes(0),
+    m_firstBlockIndex(0),
+    m_writeBlockIndex(0),
+    m_storageBytes(0),
+    m_readBlockIndex(noBlock)
+{
+}
+
+bool TemplateStorage::Empty() const
+{
+    return Count() == 0;
+}
+
+void TemplateStorage::Clear()
+{
+    m_templates.clear();
+    m_templates.shrink_to_fit();
+    m_templateIndex.clear();
+    m_templateBytes = 0;
+
+    m_storage.clear();
+    m_storage.shrink_to_fit();
+    m_storageBytes = 0;
+
+    m_writeList.clear();
+    m_writeList.shrink_to_fit();
+    m_writeTemplates.clear();
+    m_writeFields.clear();
+    m_firstBlockIndex = 0;
+    m_writeBlockIndex = 0;
+
+    m_readBlockIndex = noBlock;
+    m_readList.clear();
+    m_readList.shrink_to_fit();
+}
+
+size_t TemplateStorage::Add(std::string_view value)
+{
+    auto result = m_writeBlockIndex * blockLines + m_writeList.size();
+    m_writeTemplates.push_back(GetTemplateId(value, m_writeFields));
+    m_writeList.emplace_back(value);
+    if (m_writeList.size() == blockLines)
+    {
+        SealWriteBlock();
+    }
+    return result;
+}
+
+size_t TemplateStorage::Count() const
+{
+    return EndIndex() - BeginIndex();
+}
+
+std::string TemplateStorage::operator[](size_t i)
+{
+    return std::string(View(i));
+}
+
+std::string_view TemplateStorage::View(size_t i)
+{
+    auto blockId = i / blockLines;
+    auto id = i % blockLines;
+
+    if (blockId == m_writeBlockIndex)
+    {
+        return m_writeList[id];
+    }
+    return GetBlock(blockId)[id];
+}
+
+size_t TemplateStorage::BeginIndex() const
+{
+    return m_firstBlockIndex * blockLines;
+}
+
+size_t TemplateStorage::EndIndex() const
+{
+    return m_writeBlockIndex * blockLines + m_writeList.size();
+}
+
+size_t TemplateStorage::FrontBlockCount() const
+{
+    return m_storage.empty() ? 0 : blockLines;
+}
+
+size_t TemplateStorage::PopFrontBlock()
+{
+    if (m_storage.empty())
+    {
+        return 0;
+    }
+
+    if (m_readBlockIndex == m_firstBlockIndex)
+    {
+        m_readBlockIndex = noBlock;
+        m_readList.clear();
+    }
+
+    m_storageBytes -= m_storage.front().size();
+    m_storage.pop_front();
+    ++m_firstBlockIndex;
+    return blockLines;
+}
+
+void TemplateStorage::Prefetch(size_t /*beginIndex*/, size_t /*endIndex*/)
+{
+}
+
+void TemplateStorage::Flush()
+{
+}
+
+bool TemplateStorage::MayContain(size_t /*index*/, std::string_view /*text*/) const
+{
+    return true;
+}
+
+size_t TemplateStorage::GetBlockEnd(size_t index) const
+{
+    return std::min((index / blockLines + 1) * blockLines, EndIndex());
+}
+
+size_t TemplateStorage::GetStorageSize() const
+{
+    return m_storageBytes + m_templateBytes;
+}
+
+size_t TemplateStorage::GetTemplateCount() const
+{
+    return m_templates.size();
+}
+
+void TemplateStorage::shrink_to_fit()
+{
+    m_writeList.shrink_to_fit();
+    m_storage.shrink_to_fit();
+}
+
+// returns 0 for a line that is stored as is, otherwise the template id + 1 and
+// appends the values of the numeric fields to 'fields'.
+uint32_t TemplateStorage::GetTemplateId(std::string_view value, std::vector<uint64_t>& fields)
+{
+    if (value.find(fieldMarker) != std::string_view::npos)
+    {
+        return 0;
+    }
+
+    std::string text;
+    text.reserve(value.size());
+    auto fieldCount = fields.size();
+    size_t i = 0;
+    while (i < value.size())
+    {
+        if (!IsDigit(value[i]))
+        {
+            text.push_back(value[i]);
+            ++i;
+            continue;
+        }
+
+        auto begin = i;
+        while (i < value.size() && IsDigit(value[i]))
+        {
+            ++i;
+        }
+        auto digits = value.substr(begin, i - begin);
+
+        // a leading zero would not survive the round trip through an integer
+        if (digits.size() > maxFieldDigits || (digits.size() > 1 && digits[0] == '0'))
+        {
+            text.append(digits);
+            continue;
+        }
+
+        uint64_t field = 0;
+        for (auto c : digits)
+        {
+            field = field * 10 + (c - '0');
+        }
+        fields.push_back(field);
+        text.push_back(fieldMarker);
+    }
+
+    auto it = m_templateIndex.find(text);
+    if (it != m_templateIndex.end())
+    {
+        return it->second;
+    }
+
+    if (m_templates.size() == maxTemplates)
+    {
+        fields.resize(fieldCount);
+        return 0;
+    }
+
+    m_templateBytes += 2 * text.size(); // stored in m_templates and as key of m_templateIndex
+    m_templates.push_back(Template{text, fields.size() - fieldCount});
+    auto id = static_cast<uint32_t>(m_templates.size());
+    m_templateIndex.emplace(std::move(text), id);
+    return id;
+}
+
+void TemplateStorage::SealWriteBlock()
+{
+    m_storage.push_back(Encode());
+    m_storageBytes += m_storage.back().size();
+
+    m_writeList.clear();
+    m_writeTemplates.clear();
+    m_writeFields.clear();
+    ++m_writeBlockIndex;
+}
+
+// block layout before compression:
+// line count, size + template id column, size + column of lines without template, field column
+std::string TemplateStorage::Encode() const
+{
+    std::string ids;
+    std::string lines;
+    std::string values;
+    std::unordered_map<uint32_t, std::vector<uint64_t>> previous;
+    size_t field = 0;
+    for (size_t i = 0; i < m_writeList.size(); ++i)
+    {
+        auto id = m_writeTemplates[i];
+        PutVarint(ids, id);
+        if (id == 0)
+        {
+            PutVarint(lines, m_writeList[i].size());
+            lines.append(m_writeList[i]);
+            continue;
+        }
+
+        auto& last = previous[id];
+        last.resize(m_templates[id - 1].fields);
+        for (auto& lastValue : last)
+        {
+            auto value = m_writeFields[field++];
+            PutVarint(values, ZigZag(value - lastValue));
+            lastValue = value;
+        }
+    }
+
+    std::string data;
+    PutVarint(data, m_writeList.size());
+    PutVarint(data, ids.size());
+    data.append(ids);
+    PutVarint(data, lines.size());
+    data.append(lines);
+    data.append(values);
+
+    std::string compressed;
+    snappy::Compress(data.data(), data.size(), &compressed);
+    compressed.shrink_to_fit();
+    return compressed;
+}
+
+DecodedBlock TemplateStorage::Decode(const std::string& compressed) const
+{
+    std::string data;
+    snappy::Uncompress(compressed.data(), compressed.size(), &data);
+
+    const char* p = data.data();
+    auto count = GetVarint(p);
+    auto idsSize = GetVarint(p);
+    const char* ids = p;
+    p += idsSize;
+    auto linesSize = GetVarint(p);
+    const char* lines = p;
+    const char* values = p + linesSize;
+
+    DecodedBlock block;
+    block.reserve(count);
+    std::unordered_map<uint32_t, std::vector<uint64_t>> previous;
+    for (uint64_t i = 0; i < count; ++i)
+    {
+        auto id = static_cast<uint32_t>(GetVarint(ids));
+        if (id == 0)
+        {
+            auto size = GetVarint(lines);
+            block.emplace_back(lines, size);
+            lines += size;
+            continue;
+        }
+
+        auto& tmpl = m_templates[id - 1];
+        auto& last = previous[id];
+        last.resize(tmpl.fields);
+        std::string text;
+        size_t field = 0;
+        for (auto c : tmpl.text)
+        {
+            if (c != fieldMarker)
+            {
+                text.push_back(c);
+                continue;
+            }
+
+            last[field] += UnZigZag(GetVarint(values));
+            text.append(std::to_string(last[field]));
+            ++field;
+        }
+        block.push_back(std::move(text));
+    }
+    return block;
+}
+
+// the most recently read block is kept decoded
+const DecodedBlock& TemplateStorage::GetBlock(size_t blockIndex)
+{
+    if (blockIndex != m_readBlockIndex)
+    {
+        m_readList = Decode(m_storage[blockIndex - m_firstBlockIndex]);
+        m_readBlockIndex = blockIndex;
+    }
+    return m_readList;
+}
+
+} // namespace indexedstorage
+} // namespace fusion
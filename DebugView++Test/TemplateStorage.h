@@ -0,0 +1,90 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <deque>
+#include <string>
+#include <string_view>
+#include <memory>
+#include <unordered_map>
+#include "IndexedStorageLib/IndexedStorage.h"
+
+namespace fusion {
+namespace indexedstorage {
+
+// Stores printf-style lines as a message template plus its numeric fields.
+// "connect 10.0.0.1 port 8080" becomes template "connect \1.\1.\1.\1 port \1" and the values 10, 0, 0, 1, 8080.
+// Sealed blocks store the columns template ids, fields (delta to the previous line with the same template)
+// and lines without a template, varint encoded and snappy compressed. Access reconstructs the exact original text.
+// Only used to measure the template encoding against SnappyStorage in the tests, it is not a LogFile storage:
+// it has no block limits, memory budget, background compression or trigram synopsis.
+class TemplateStorage
+{
+public:
+    TemplateStorage();
+
+    [[nodiscard]] bool Empty() const;
+    void Clear();
+    size_t Add(std::string_view value);
+    [[nodiscard]] size_t Count() const;
+    std::string operator[](size_t i);
+
+    // the view is valid until the next call of a non-const member function
+    std::string_view View(size_t i);
+
+    [[nodiscard]] size_t BeginIndex() const;
+    [[nodiscard]] size_t EndIndex() const;
+    [[nodiscard]] size_t FrontBlockCount() const;
+    size_t PopFrontBlock();
+
+    // blocks are encoded by Add() and decoded on access, there is nothing to prefetch or flush
+    void Prefetch(size_t beginIndex, size_t endIndex);
+    void Flush();
+
+    // blocks carry no synopsis, any block may contain any text
+    [[nodiscard]] bool MayContain(size_t index, std::string_view text) const;
+    [[nodiscard]] size_t GetBlockEnd(size_t index) const;
+
+    // bytes held by the sealed blocks and the template dictionary
+    [[nodiscard]] size_t GetStorageSize() const;
+    [[nodiscard]] size_t GetTemplateCount() const;
+    void shrink_to_fit();
+
+private:
+    struct Template
+    {
+        std::string text;
+        size_t fields;
+    };
+
+    uint32_t GetTemplateId(std::string_view value, std::vector<uint64_t>& fields);
+    void SealWriteBlock();
+    std::string Encode() const;
+    DecodedBlock Decode(const std::string& compressed) const;
+    const DecodedBlock& GetBlock(size_t blockIndex);
+
+    std::vector<Template> m_templates;
+    std::unordered_map<std::string, uint32_t> m_templateIndex;
+    size_t m_templateBytes;
+
+    size_t m_firstBlockIndex;
+    size_t m_writeBlockIndex;
+    std::vector<std::string> m_writeList;
+    std::vector<uint32_t> m_writeTemplates; // per line, 0 is a line without template
+    std::vector<uint64_t> m_writeFields;
+    std::deque<std::string> m_storage;
+    size_t m_storageBytes;
+
+    size_t m_readBlockIndex;
+    DecodedBlock m_readList;
+};
+
+} // namespace indexedstorage
+} // namespace fusion
@@ -0,0 +1,26 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+
+namespace fusion {
+namespace debugviewpp {
+
+class ILineBuffer;
+
+// test data shared by the unit tests and the benchmarks
+std::string GetTestString(size_t i);
+std::string GetMixedTestString(size_t i);
+std::string GetTemplateTestString(size_t i);
+
+// returns the seconds until the consumer received all lines
+double RunLineBufferProducers(ILineBuffer& buffer, size_t producers, size_t linesPerProducer, bool& ordered);
+
+} // namespace debugviewpp
+} // namespace fusion
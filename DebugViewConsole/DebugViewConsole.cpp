@@ -26,9 +26,11 @@
 #include "DebugView++Lib/LogSources.h"
 #include "DebugView++Lib/Conversions.h"
 #include "DebugView++Lib/LineBuffer.h"
+#include "DebugView++Lib/LineBatch.h"
 #include "../DebugView++/version.h"
 
 #include "DebugView++Lib/Filter.h"
+#include "DebugView++Lib/FilterProgram.h"
 #include "DebugView++Lib/LogFile.h"
 
 #define DOCOPT_HEADER_ONLY
@@ -57,7 +59,7 @@ struct Settings
     std::string quitmessage;
 };
 
-void OutputDetails(Settings settings, const Line& line)
+void OutputDetails(Settings settings, const LineRef& line)
 {
     std::string separator = settings.tabs ? "\t" : " ";
     if (settings.timestamp)
@@ -74,7 +76,7 @@ void OutputDetails(Settings settings, const Line& line)
     }
     if (settings.processName)
     {
-        std::cout << line.processName.c_str() << separator;
+        std::cout << line.processName << separator;
     }
 }
 
@@ -86,7 +88,7 @@ void Quit()
     g_quit = true;
 }
 
-bool ContainsText(const std::string& line, const std::string& message)
+bool ContainsText(std::string_view line, const std::string& message)
 {
     if (message.empty())
         return false;
@@ -112,10 +114,11 @@ void AddProcessFilter(LogFilter& filter, FilterType::type filterType, const std:
     filter.processFilters.push_back(Filter(pattern, MatchType::Simple, filterType, bgColor, fgColor));
 }
 
-bool IsIncluded(LogFilter& filter, const Line& line)
+// the program must be updated for the filter
+bool IsIncluded(FilterProgram& program, LogFilter& filter, const LineRef& line)
 {
     MatchColors matchcolors; //  not used on the command-line
-    return IsIncluded(filter.processFilters, line.processName, matchcolors) && IsIncluded(filter.messageFilters, line.message, matchcolors);
+    return (program.Run(filter, line.message, line.processName, matchcolors, FilterResult::Include).flags & FilterResult::Include) != 0;
 }
 
 void LogMessages(Settings settings)
@@ -150,6 +153,8 @@ void LogMessages(Settings settings)
     {
         AddProcessFilter(filter, FilterType::Exclude, value);
     }
+    FilterProgram program;
+    program.Update(filter);
 
     std::ofstream fs;
     if (!settings.filename.empty())
@@ -168,22 +173,24 @@ void LogMessages(Settings settings)
     });
 
     std::string separator = settings.tabs ? "\t" : " ";
+    LineBatch lines;
     while (!g_quit && (!IsEventSet(g_quitMessageHandle)))
     {
-        Lines lines;
         executor.Call([&] {
-            lines = logsources.GetLines();
+            lines.Clear();
+            logsources.GetLines(lines);
         });
         int linenumber = 0;
-        for (const auto& line : lines)
+        for (size_t i = 0; i < lines.Count(); ++i)
         {
+            auto line = lines[i];
             if (ContainsText(line.message, settings.quitmessage))
             {
                 Quit();
                 break;
             }
 
-            if (!debugviewpp::IsIncluded(filter, line))
+            if (!debugviewpp::IsIncluded(program, filter, line))
                 continue;
 
             if (settings.console)
@@ -194,7 +201,7 @@ void LogMessages(Settings settings)
                     std::cout << std::setw(5) << std::setfill('0') << linenumber << std::setfill(' ') << separator;
                 }
                 OutputDetails(settings, line);
-                std::cout << separator << line.message.c_str() << "\n";
+                std::cout << separator << line.message << "\n";
             }
             if (!settings.filename.empty())
             {
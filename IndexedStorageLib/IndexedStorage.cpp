@@ -6,14 +6,27 @@
 // Repository at: https://github.com/djeedjay/DebugViewPP/
 
 #include "stdafx.h"
+#include <windows.h>
 #include <vector>
+#include <stdexcept>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <functional>
+#include <future>
+#include <unordered_set>
+#include <algorithm>
+#include "CobaltFusion/SynchronizedQueue.h"
 #include "IndexedStorageLib/IndexedStorage.h"
 #include "snappy.h"
 
 namespace fusion {
 namespace indexedstorage {
 
-const int blockSize = 400;
+const size_t defaultBlockBytes = 32 * 1024;
+const size_t defaultMinBlockLines = 16;
+const size_t defaultMaxBlockLines = 4096;
+const size_t defaultCacheSize = 16 * 1024 * 1024;
 
 bool VectorStorage::Empty() const
 {
@@ -26,9 +39,9 @@ void VectorStorage::Clear()
     m_storage.shrink_to_fit();
 }
 
-size_t VectorStorage::Add(const std::string& value)
+size_t VectorStorage::Add(std::string_view value)
 {
-    m_storage.push_back(value);
+    m_storage.emplace_back(value);
     return m_storage.size() - 1;
 }
 
@@ -42,111 +55,806 @@ std::string VectorStorage::operator[](size_t i) const
     return m_storage[i];
 }
 
+std::string_view VectorStorage::View(size_t i) const
+{
+    return m_storage[i];
+}
+
 void VectorStorage::shrink_to_fit()
 {
     m_storage.shrink_to_fit();
 }
 
+// append-only temporary file for blocks spilled from memory, the file is deleted when it is closed.
+// Write() is only called by the owning thread, Decompress() also by the worker thread.
+class ScratchFile
+{
+public:
+    ScratchFile() :
+        m_mapping(nullptr),
+        m_size(0),
+        m_mappedSize(0)
+    {
+        wchar_t path[MAX_PATH];
+        wchar_t fileName[MAX_PATH];
+        if (GetTempPathW(MAX_PATH, path) == 0 || GetTempFileNameW(path, L"dvp", 0, fileName) == 0)
+        {
+            throw std::runtime_error("cannot create scratch file name");
+        }
+
+        m_file = CreateFileW(fileName, GENERIC_READ | GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, nullptr);
+        if (m_file == INVALID_HANDLE_VALUE)
+        {
+            throw std::runtime_error("cannot create scratch file");
+        }
+
+        SYSTEM_INFO info;
+        GetSystemInfo(&info);
+        m_granularity = info.dwAllocationGranularity;
+    }
+
+    ~ScratchFile()
+    {
+        if (m_mapping != nullptr)
+        {
+            CloseHandle(m_mapping);
+        }
+        CloseHandle(m_file);
+    }
+
+    ScratchFile(const ScratchFile&) = delete;
+    ScratchFile& operator=(const ScratchFile&) = delete;
+
+    // returns the offset of the data in the file
+    uint64_t Write(const std::string& data)
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        LARGE_INTEGER position;
+        position.QuadPart = static_cast<LONGLONG>(m_size);
+        DWORD written = 0;
+        if (SetFilePointerEx(m_file, position, nullptr, FILE_BEGIN) == FALSE ||
+            WriteFile(m_file, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) == FALSE ||
+            written != data.size())
+        {
+            throw std::runtime_error("cannot write scratch file");
+        }
+
+        auto offset = m_size;
+        m_size += data.size();
+        return offset;
+    }
+
+    // decompresses the block directly from a mapped view of the file
+    DecodedBlock Decompress(uint64_t offset, size_t size)
+    {
+        auto viewOffset = offset - offset % m_granularity;
+        auto viewSize = static_cast<size_t>(offset - viewOffset) + size;
+        void* view = nullptr;
+        {
+            // the file grows after a mapping is created, the mapping is renewed when it does not cover the block.
+            // Views stay valid when their mapping handle is closed.
+            std::lock_guard<std::mutex> lock(m_mutex);
+            if (offset + size > m_mappedSize)
+            {
+                if (m_mapping != nullptr)
+                {
+                    CloseHandle(m_mapping);
+                }
+                m_mapping = CreateFileMappingW(m_file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+                m_mappedSize = m_mapping != nullptr ? m_size : 0;
+            }
+            if (m_mapping != nullptr)
+            {
+                view = MapViewOfFile(m_mapping, FILE_MAP_READ, static_cast<DWORD>(viewOffset >> 32), static_cast<DWORD>(viewOffset), viewSize);
+            }
+        }
+        if (view == nullptr)
+        {
+            throw std::runtime_error("cannot map scratch file");
+        }
+
+        struct ViewGuard
+        {
+            ~ViewGuard() { UnmapViewOfFile(view); }
+            void* view;
+        } guard{view};
+
+        return SnappyStorage::Decompress(static_cast<const char*>(view) + (offset - viewOffset), size);
+    }
+
+private:
+    std::mutex m_mutex;
+    HANDLE m_file;
+    HANDLE m_mapping;
+    uint64_t m_size;
+    uint64_t m_mappedSize;
+    DWORD m_granularity;
+};
+
+unsigned char ToLowerAscii(char c)
+{
+    auto u = static_cast<unsigned char>(c);
+    return u >= 'A' && u <= 'Z' ? static_cast<unsigned char>(u - 'A' + 'a') : u;
+}
+
+uint32_t GetTrigram(const char* p)
+{
+    return (ToLowerAscii(p[0]) << 16) | (ToLowerAscii(p[1]) << 8) | ToLowerAscii(p[2]);
+}
+
+// the bloom filter sets 3 bits per trigram, derived from one 64 bit hash by double hashing
+template <typename Fn>
+void ForEachTrigramBit(uint32_t trigram, size_t bits, Fn fn)
+{
+    auto hash = trigram * 0x9E3779B97F4A7C15ull;
+    hash ^= hash >> 29;
+    auto h1 = static_cast<uint32_t>(hash);
+    auto h2 = static_cast<uint32_t>(hash >> 32) | 1;
+    for (uint32_t i = 0; i < 3; ++i)
+    {
+        fn((h1 + i * h2) & (bits - 1));
+    }
+}
+
+// 4 to 8 bits per distinct trigram of the block gives 3% to 15% false positives per trigram
+// and far less for a text of several trigrams. The filter takes at most 1/16 of the size of the strings,
+// a block with more distinct trigrams than that allows (random ids, hex dumps) gets no filter, since
+// nearly every text would pass it anyway.
+std::vector<uint64_t> MakeTrigramFilter(const DecodedBlock& block)
+{
+    std::vector<uint32_t> trigrams;
+    for (auto& s : block)
+    {
+        for (size_t i = 2; i < s.size(); ++i)
+        {
+            trigrams.push_back(GetTrigram(s.data() + i - 2));
+        }
+    }
+    auto maxBits = std::max<size_t>(trigrams.size() / 2, 64);
+    std::sort(trigrams.begin(), trigrams.end());
+    trigrams.erase(std::unique(trigrams.begin(), trigrams.end()), trigrams.end());
+
+    size_t bits = 64;
+    while (bits < 4 * trigrams.size() && 2 * bits <= maxBits)
+    {
+        bits *= 2;
+    }
+    if (bits < 4 * trigrams.size())
+    {
+        return std::vector<uint64_t>();
+    }
+
+    std::vector<uint64_t> filter(bits / 64);
+    for (auto trigram : trigrams)
+    {
+        ForEachTrigramBit(trigram, bits, [&filter](size_t bit) { filter[bit / 64] |= uint64_t(1) << (bit % 64); });
+    }
+    return filter;
+}
+
+bool MayContainTrigrams(const std::vector<uint64_t>& filter, std::string_view text)
+{
+    auto bits = filter.size() * 64;
+    for (size_t i = 2; i < text.size(); ++i)
+    {
+        bool found = true;
+        ForEachTrigramBit(GetTrigram(text.data() + i - 2), bits, [&filter, &found](size_t bit) { found = found && (filter[bit / 64] & (uint64_t(1) << (bit % 64))) != 0; });
+        if (!found)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+struct CompressedBlock
+{
+    size_t blockIndex;
+    std::string compressed;
+    std::vector<uint64_t> trigrams;
+};
+
+// compresses sealed blocks and decodes prefetched blocks on a background thread,
+// the results are collected by SnappyStorage on the calling thread so the storage
+// and the block cache need no locking.
+class BlockWorker
+{
+public:
+    BlockWorker() :
+        m_end(false),
+        m_thread([this] { Run(); })
+    {
+    }
+
+    ~BlockWorker()
+    {
+        m_end = true;
+        m_q.Push([] {});
+        m_thread.join();
+    }
+
+    bool IsDecoding(size_t blockIndex) const
+    {
+        return m_pending.find(blockIndex) != m_pending.end();
+    }
+
+    void Decode(size_t blockIndex, const std::string& compressed)
+    {
+        ScheduleDecode(blockIndex, [compressed] { return SnappyStorage::Decompress(compressed); });
+    }
+
+    void Decode(size_t blockIndex, std::shared_ptr<ScratchFile> file, uint64_t offset, size_t size)
+    {
+        ScheduleDecode(blockIndex, [file, offset, size] { return file->Decompress(offset, size); });
+    }
+
+    void Compress(size_t blockIndex, std::shared_ptr<const DecodedBlock> block)
+    {
+        m_q.Push([this, blockIndex, block] {
+            if (m_end)
+            {
+                return;
+            }
+            auto compressed = SnappyStorage::Compress(*block);
+            compressed.shrink_to_fit(); // snappy reserves the worst case size
+            auto trigrams = MakeTrigramFilter(*block);
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_compressed.push_back(CompressedBlock{blockIndex, std::move(compressed), std::move(trigrams)});
+        });
+    }
+
+    // waits until all work queued so far is done
+    void Flush()
+    {
+        std::promise<void> done;
+        auto future = done.get_future();
+        m_q.Push([&done] { done.set_value(); });
+        future.wait();
+    }
+
+    std::vector<CompressedBlock> TakeCompressed()
+    {
+        std::vector<CompressedBlock> compressed;
+        std::lock_guard<std::mutex> lock(m_mutex);
+        compressed.swap(m_compressed);
+        return compressed;
+    }
+
+    std::vector<std::pair<size_t, std::shared_ptr<const DecodedBlock>>> TakeDecoded()
+    {
+        std::vector<std::pair<size_t, std::shared_ptr<const DecodedBlock>>> decoded;
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            decoded.swap(m_decoded);
+        }
+        for (auto& item : decoded)
+        {
+            m_pending.erase(item.first);
+        }
+        return decoded;
+    }
+
+private:
+    // a block that fails to decode stays pending, it is decoded again when it is accessed
+    template <typename Decoder>
+    void ScheduleDecode(size_t blockIndex, Decoder decode)
+    {
+        m_pending.insert(blockIndex);
+        m_q.Push([this, blockIndex, decode] {
+            if (m_end)
+            {
+                return;
+            }
+            std::shared_ptr<const DecodedBlock> block;
+            try
+            {
+                block = std::make_shared<const DecodedBlock>(decode());
+            }
+            catch (std::exception&)
+            {
+                return;
+            }
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_decoded.emplace_back(blockIndex, std::move(block));
+        });
+    }
+
+    void Run()
+    {
+        while (!m_end)
+        {
+            m_q.Pop()();
+        }
+    }
+
+    std::atomic<bool> m_end;
+    std::unordered_set<size_t> m_pending; // only accessed by the owning thread
+    std::mutex m_mutex;                   // protects m_decoded and m_compressed
+    std::vector<std::pair<size_t, std::shared_ptr<const DecodedBlock>>> m_decoded;
+    std::vector<CompressedBlock> m_compressed;
+    SynchronizedQueue<std::function<void()>> m_q;
+    std::thread m_thread;
+};
+
+size_t GetDecodedSize(const DecodedBlock& block)
+{
+    size_t bytes = block.capacity() * sizeof(std::string);
+    for (auto& s : block)
+    {
+        bytes += s.capacity();
+    }
+    return bytes;
+}
+
+SnappyStorage::CacheEntry::CacheEntry(size_t blockIndex, std::shared_ptr<const DecodedBlock> block) :
+    blockIndex(blockIndex),
+    block(std::move(block)),
+    bytes(GetDecodedSize(*this->block))
+{
+}
+
 SnappyStorage::SnappyStorage() :
+    m_firstBlockIndex(0),
     m_writeBlockIndex(0),
-    m_readBlockIndex(-1)
+    m_writeBeginIndex(0),
+    m_writeBytes(0),
+    m_storageBytes(0),
+    m_memoryBudget(0),
+    m_spilledBlocks(0),
+    m_spilledBytes(0),
+    m_blockBytes(defaultBlockBytes),
+    m_minBlockLines(defaultMinBlockLines),
+    m_maxBlockLines(defaultMaxBlockLines),
+    m_cacheSize(defaultCacheSize),
+    m_cacheBytes(0)
 {
 }
 
+SnappyStorage::~SnappyStorage() = default;
+
+SnappyStorage::SnappyStorage(SnappyStorage&&) noexcept = default;
+
+SnappyStorage& SnappyStorage::operator=(SnappyStorage&&) noexcept = default;
+
 bool SnappyStorage::Empty() const
 {
-    return m_storage.empty();
+    return Count() == 0;
 }
 
 void SnappyStorage::Clear()
 {
+    m_worker.reset();
+
     m_storage.clear();
     m_storage.shrink_to_fit();
+    m_blockBegin.clear();
+    m_blockBegin.shrink_to_fit();
+    m_storageBytes = 0;
+
+    m_scratchFile.reset();
+    m_spilledBlocks = 0;
+    m_spilledBytes = 0;
 
-    m_readList.clear();
-    m_readList.shrink_to_fit();
-    m_readBlockIndex = -1;
+    m_cache.clear();
+    m_cacheIndex.clear();
+    m_cacheBytes = 0;
+    m_pinnedBlock.reset();
 
     m_writeList.clear();
     m_writeList.shrink_to_fit();
+    m_firstBlockIndex = 0;
     m_writeBlockIndex = 0;
+    m_writeBeginIndex = 0;
+    m_writeBytes = 0;
 }
 
-size_t SnappyStorage::Add(const std::string& value)
+size_t SnappyStorage::Add(std::string_view value)
 {
-    auto id = m_writeList.size();
-    m_writeList.push_back(value);
-    auto result = m_writeBlockIndex * blockSize + id;
-    if (id == blockSize - 1)
+    auto result = m_writeBeginIndex + m_writeList.size();
+    m_writeList.emplace_back(value);
+    m_writeBytes += value.size();
+
+    // seal by size so blocks of short and of very long lines decode in about the same time
+    auto lines = m_writeList.size();
+    if ((m_writeBytes >= m_blockBytes && lines >= m_minBlockLines) || lines >= m_maxBlockLines)
     {
-        std::string test = Compress(m_writeList);
-        m_storage.push_back(test);
-        m_writeList.clear();
-        ++m_writeBlockIndex;
+        SealWriteBlock();
     }
     return result;
 }
 
-size_t SnappyStorage::Count() const
+void SnappyStorage::SetBlockLimits(size_t blockBytes, size_t minLines, size_t maxLines)
 {
-    return m_storage.size();
+    m_blockBytes = blockBytes;
+    m_minBlockLines = std::max<size_t>(minLines, 1);
+    m_maxBlockLines = std::max(maxLines, m_minBlockLines);
 }
 
-std::string SnappyStorage::operator[](size_t i)
+// the full write block is compressed by the worker thread,
+// until then readers are served from the uncompressed block.
+void SnappyStorage::SealWriteBlock()
+{
+    CollectWork();
+
+    auto block = std::make_shared<const DecodedBlock>(std::move(m_writeList));
+    m_writeList.clear();
+
+    m_storageBytes += GetDecodedSize(*block);
+    m_storage.push_back(Block{std::string(), block});
+    m_blockBegin.push_back(m_writeBeginIndex);
+    m_writeBeginIndex += block->size();
+    m_writeBytes = 0;
+    GetWorker().Compress(m_writeBlockIndex, std::move(block));
+    ++m_writeBlockIndex;
+}
+
+void SnappyStorage::Flush()
+{
+    if (m_worker)
+    {
+        m_worker->Flush();
+        CollectWork();
+    }
+}
+
+size_t SnappyStorage::GetStorageSize() const
 {
-    return GetString(i);
+    return m_storageBytes;
 }
 
-size_t SnappyStorage::GetBlockIndex(size_t index)
+size_t SnappyStorage::GetMemoryBudget() const
 {
-    return index / blockSize;
+    return m_memoryBudget;
 }
 
-size_t SnappyStorage::GetRelativeIndex(size_t index)
+void SnappyStorage::SetMemoryBudget(size_t bytes)
 {
-    return index % blockSize;
+    m_memoryBudget = bytes;
+    SpillBlocks();
 }
 
-std::string SnappyStorage::GetString(size_t index)
+size_t SnappyStorage::GetSpilledSize() const
 {
-    auto blockId = GetBlockIndex(index);
-    auto id = GetRelativeIndex(index);
+    return m_spilledBytes;
+}
+
+// writes the oldest compressed blocks to the scratch file until the blocks in memory fit the budget,
+// blocks are spilled in order so the spilled blocks are always the first m_spilledBlocks in m_storage.
+void SnappyStorage::SpillBlocks()
+{
+    while (m_memoryBudget > 0 && m_storageBytes > m_memoryBudget && m_spilledBlocks < m_storage.size())
+    {
+        auto& block = m_storage[m_spilledBlocks];
+        if (block.uncompressed)
+        {
+            return;
+        }
+
+        try
+        {
+            if (!m_scratchFile)
+            {
+                m_scratchFile = std::make_shared<ScratchFile>();
+            }
+            block.spillOffset = m_scratchFile->Write(block.compressed);
+        }
+        catch (std::exception&)
+        {
+            // keep everything in memory when the scratch file cannot be used
+            m_memoryBudget = 0;
+            return;
+        }
+
+        block.spillSize = block.compressed.size();
+        m_storageBytes -= block.spillSize;
+        m_spilledBytes += block.spillSize;
+        std::string().swap(block.compressed);
+        ++m_spilledBlocks;
+    }
+}
+
+size_t SnappyStorage::Count() const
+{
+    return EndIndex() - BeginIndex();
+}
+
+std::string SnappyStorage::operator[](size_t i)
+{
+    return std::string(View(i));
+}
+
+std::string_view SnappyStorage::View(size_t i)
+{
+    auto blockId = GetBlockIndex(i);
+    auto id = GetRelativeIndex(i, blockId);
 
     if (blockId == m_writeBlockIndex)
     {
         return m_writeList[id];
     }
 
-    if (blockId != m_readBlockIndex)
+    auto& block = GetBlock(blockId);
+    if (m_pinnedBlock != block)
     {
-        m_readList = Decompress(m_storage[blockId]);
-        m_readBlockIndex = blockId;
+        m_pinnedBlock = block;
     }
-    return m_readList[id];
+    return (*m_pinnedBlock)[id];
 }
 
-std::string SnappyStorage::Compress(const std::vector<std::string>& value) const
+size_t SnappyStorage::BeginIndex() const
 {
-    std::vector<char> raw;
-    for (auto& s : value)
+    return m_blockBegin.empty() ? m_writeBeginIndex : m_blockBegin.front();
+}
+
+size_t SnappyStorage::EndIndex() const
+{
+    return m_writeBeginIndex + m_writeList.size();
+}
+
+size_t SnappyStorage::FrontBlockCount() const
+{
+    if (m_blockBegin.empty())
+    {
+        return 0;
+    }
+    return (m_blockBegin.size() > 1 ? m_blockBegin[1] : m_writeBeginIndex) - m_blockBegin.front();
+}
+
+size_t SnappyStorage::PopFrontBlock()
+{
+    if (m_storage.empty())
+    {
+        return 0;
+    }
+
+    auto it = m_cacheIndex.find(m_firstBlockIndex);
+    if (it != m_cacheIndex.end())
+    {
+        m_cacheBytes -= it->second->bytes;
+        m_cache.erase(it->second);
+        m_cacheIndex.erase(it);
+    }
+
+    auto count = FrontBlockCount();
+    auto& block = m_storage.front();
+    if (m_spilledBlocks > 0)
+    {
+        // the space in the scratch file is not reused
+        m_spilledBytes -= block.spillSize;
+        --m_spilledBlocks;
+    }
+    else
+    {
+        m_storageBytes -= block.uncompressed ? GetDecodedSize(*block.uncompressed) : block.compressed.size();
+    }
+    m_storageBytes -= block.trigrams.size() * sizeof(uint64_t);
+    m_storage.pop_front();
+    m_blockBegin.pop_front();
+    ++m_firstBlockIndex;
+    return count;
+}
+
+void SnappyStorage::Prefetch(size_t beginIndex, size_t endIndex)
+{
+    if (m_storage.empty() || beginIndex > endIndex || endIndex < BeginIndex() || beginIndex >= m_writeBeginIndex)
+    {
+        return;
+    }
+
+    auto firstBlock = GetBlockIndex(std::max(beginIndex, BeginIndex()));
+    auto lastBlock = std::min(GetBlockIndex(std::min(endIndex, EndIndex() - 1)), m_writeBlockIndex - 1);
+    for (auto blockIndex = firstBlock; blockIndex <= lastBlock; ++blockIndex)
+    {
+        auto& block = m_storage[blockIndex - m_firstBlockIndex];
+        if (block.uncompressed || m_cacheIndex.find(blockIndex) != m_cacheIndex.end())
+        {
+            continue;
+        }
+
+        auto& worker = GetWorker();
+        if (worker.IsDecoding(blockIndex))
+        {
+            continue;
+        }
+        if (IsSpilled(blockIndex))
+        {
+            worker.Decode(blockIndex, m_scratchFile, block.spillOffset, block.spillSize);
+        }
+        else
+        {
+            worker.Decode(blockIndex, block.compressed);
+        }
+    }
+}
+
+bool SnappyStorage::MayContain(size_t index, std::string_view text) const
+{
+    auto blockIndex = GetBlockIndex(index);
+    if (blockIndex == m_writeBlockIndex || text.size() < 3)
+    {
+        return true;
+    }
+
+    auto& block = m_storage[blockIndex - m_firstBlockIndex];
+    return block.trigrams.empty() || MayContainTrigrams(block.trigrams, text);
+}
+
+size_t SnappyStorage::GetBlockEnd(size_t index) const
+{
+    auto blockIndex = GetBlockIndex(index);
+    if (blockIndex + 1 >= m_writeBlockIndex)
+    {
+        return blockIndex == m_writeBlockIndex ? EndIndex() : m_writeBeginIndex;
+    }
+    return m_blockBegin[blockIndex + 1 - m_firstBlockIndex];
+}
+
+size_t SnappyStorage::GetCacheSize() const
+{
+    return m_cacheSize;
+}
+
+void SnappyStorage::SetCacheSize(size_t bytes)
+{
+    m_cacheSize = bytes;
+    TrimCache();
+}
+
+size_t SnappyStorage::GetBlockIndex(size_t index) const
+{
+    if (index >= m_writeBeginIndex)
+    {
+        return m_writeBlockIndex;
+    }
+
+    auto it = std::upper_bound(m_blockBegin.begin(), m_blockBegin.end(), index);
+    return m_firstBlockIndex + (it - m_blockBegin.begin()) - 1;
+}
+
+size_t SnappyStorage::GetRelativeIndex(size_t index, size_t blockIndex) const
+{
+    if (blockIndex == m_writeBlockIndex)
+    {
+        return index - m_writeBeginIndex;
+    }
+    return index - m_blockBegin[blockIndex - m_firstBlockIndex];
+}
+
+// the returned block is the front of the cache, it stays valid until the next cache insertion
+const std::shared_ptr<const DecodedBlock>& SnappyStorage::GetBlock(size_t blockIndex)
+{
+    auto& block = m_storage[blockIndex - m_firstBlockIndex];
+    if (block.uncompressed)
+    {
+        return block.uncompressed;
+    }
+
+    if (!FindCachedBlock(blockIndex))
     {
-        for (auto t : s)
+        CollectWork();
+        if (!FindCachedBlock(blockIndex))
         {
-            raw.push_back(t);
+            auto decoded = IsSpilled(blockIndex) ? m_scratchFile->Decompress(block.spillOffset, block.spillSize) : Decompress(block.compressed);
+            InsertCachedBlock(blockIndex, std::make_shared<const DecodedBlock>(std::move(decoded)));
         }
+    }
+    return m_cache.front().block;
+}
+
+bool SnappyStorage::FindCachedBlock(size_t blockIndex)
+{
+    auto it = m_cacheIndex.find(blockIndex);
+    if (it == m_cacheIndex.end())
+    {
+        return false;
+    }
+
+    // move to the front of the list, iterators stay valid
+    m_cache.splice(m_cache.begin(), m_cache, it->second);
+    return true;
+}
+
+void SnappyStorage::InsertCachedBlock(size_t blockIndex, std::shared_ptr<const DecodedBlock> block)
+{
+    if (m_cacheIndex.find(blockIndex) != m_cacheIndex.end())
+    {
+        return;
+    }
+
+    m_cache.emplace_front(blockIndex, std::move(block));
+    m_cacheIndex[blockIndex] = m_cache.begin();
+    m_cacheBytes += m_cache.front().bytes;
+    TrimCache();
+}
+
+bool SnappyStorage::IsSpilled(size_t blockIndex) const
+{
+    return blockIndex - m_firstBlockIndex < m_spilledBlocks;
+}
+
+BlockWorker& SnappyStorage::GetWorker()
+{
+    if (!m_worker)
+    {
+        m_worker = std::make_unique<BlockWorker>();
+    }
+    return *m_worker;
+}
+
+void SnappyStorage::CollectWork()
+{
+    if (!m_worker)
+    {
+        return;
+    }
+
+    // skip blocks that were removed while the worker was busy with them
+    for (auto& item : m_worker->TakeCompressed())
+    {
+        if (item.blockIndex >= m_firstBlockIndex)
+        {
+            auto& block = m_storage[item.blockIndex - m_firstBlockIndex];
+            m_storageBytes -= GetDecodedSize(*block.uncompressed);
+            m_storageBytes += item.compressed.size() + item.trigrams.size() * sizeof(uint64_t);
+            block.compressed = std::move(item.compressed);
+            block.trigrams = std::move(item.trigrams);
+            block.uncompressed.reset();
+        }
+    }
+    SpillBlocks();
+
+    for (auto& item : m_worker->TakeDecoded())
+    {
+        if (item.first >= m_firstBlockIndex)
+        {
+            InsertCachedBlock(item.first, std::move(item.second));
+        }
+    }
+}
+
+void SnappyStorage::TrimCache()
+{
+    while (m_cacheBytes > m_cacheSize && m_cache.size() > 1)
+    {
+        auto& entry = m_cache.back();
+        m_cacheBytes -= entry.bytes;
+        m_cacheIndex.erase(entry.blockIndex);
+        m_cache.pop_back();
+    }
+}
+
+std::string SnappyStorage::Compress(const std::vector<std::string>& value)
+{
+    size_t size = 0;
+    for (auto& s : value)
+    {
+        size += s.size() + 1;
+    }
+
+    std::string raw;
+    raw.reserve(size);
+    for (auto& s : value)
+    {
+        raw.append(s);
         raw.push_back('\0');
     }
+
     std::string data;
-    snappy::Compress(&raw[0], raw.size(), &data);
+    snappy::Compress(raw.data(), raw.size(), &data);
     return data;
 }
 
 std::vector<std::string> SnappyStorage::Decompress(const std::string& value)
+{
+    return Decompress(value.data(), value.size());
+}
+
+std::vector<std::string> SnappyStorage::Decompress(const char* value, size_t size)
 {
     std::vector<std::string> vec;
 
     std::string data;
-    snappy::Uncompress(value.c_str(), value.size(), &data);
+    snappy::Uncompress(value, size, &data);
 
     for (auto it = data.begin(); it != data.end(); ++it)
     {
@@ -160,7 +868,6 @@ std::vector<std::string> SnappyStorage::Decompress(const std::string& value)
 
 void SnappyStorage::shrink_to_fit()
 {
-    m_readList.shrink_to_fit();
     m_writeList.shrink_to_fit();
     m_storage.shrink_to_fit();
 }
@@ -25,6 +25,7 @@ public:
 
     void Initialize() override;
     HANDLE GetHandle() const override;
+    bool AllowsBlocking() const override;
     void Notify() override;
     void PreProcess(Line& line) const override;
     void AddLine(const std::string& line);
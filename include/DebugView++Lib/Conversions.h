@@ -8,7 +8,9 @@
 #pragma once
 
 #include <windows.h>
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include "Win32/Win32Lib.h"
 
 namespace fusion {
@@ -21,8 +23,11 @@ std::string GetDateTimeText(const FILETIME& filetime);
 std::string GetTimeText(const SYSTEMTIME& st);
 std::string GetTimeText(const FILETIME& ft);
 
+uint64_t FileTimeToUInt64(const FILETIME& ft);
+FILETIME MakeFileTime(uint64_t t);
+
 template <typename CharT>
-std::basic_string<CharT> TabsToSpaces(const std::basic_string<CharT>& s, int tabsize = 4)
+std::basic_string<CharT> TabsToSpaces(std::basic_string_view<CharT> s, int tabsize = 4)
 {
     std::basic_string<CharT> result;
     result.reserve(s.size() + static_cast<size_t>(3) * tabsize);
@@ -36,6 +41,12 @@ std::basic_string<CharT> TabsToSpaces(const std::basic_string<CharT>& s, int tab
     return result;
 }
 
+template <typename CharT>
+std::basic_string<CharT> TabsToSpaces(const std::basic_string<CharT>& s, int tabsize = 4)
+{
+    return TabsToSpaces(std::basic_string_view<CharT>(s), tabsize);
+}
+
 template <typename CharT>
 int SkipTabOffset(const std::basic_string<CharT>& s, int offset, int tabsize = 4)
 {
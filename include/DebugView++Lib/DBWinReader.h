@@ -7,6 +7,13 @@
 
 #pragma once
 
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <string>
+#include <unordered_map>
+#include <vector>
 #include "Win32/Win32Lib.h"
 #include "LogSource.h"
 
@@ -15,31 +22,60 @@ namespace debugviewpp {
 
 class ILineBuffer;
 
+// a message as copied from the DBWIN buffer by the capture thread
 struct DBWinMessage
 {
     double time;
     FILETIME systemTime;
     DWORD pid;
     std::string message;
-    HANDLE handle;
 };
 
 struct DbWinBuffer;
 
+// a capture thread copies each message from the shared DBWIN buffer into a ring and releases the buffer
+// to the next OutputDebugString caller right away. Notify() resolves the processes of the captured messages.
 class DBWinReader : public LogSource
 {
 public:
     DBWinReader(Timer& timer, ILineBuffer& lineBuffer, bool global);
+    ~DBWinReader() override;
 
+    void Abort() override;
     HANDLE GetHandle() const override;
     void Notify() override;
+    void OnProcessEnded(DWORD pid) override;
+    bool AllowsBlocking() const override;
+
+    // seconds OutputDebugString callers waited for the DBWIN buffer while the capture thread handled a message,
+    // including the waits for a free slot when the ring was full
+    double GetStallTime() const;
+    size_t GetRingFullCount() const;
 
 private:
+    void Capture();
+    void Resolve(const DBWinMessage& message);
+    bool AddCached(const DBWinMessage& message);
+    void CacheProcessName(DWORD pid, HANDLE handle);
+
     Win32::Handle m_hBuffer;
     Win32::Handle m_dbWinBufferReady;
     Win32::Handle m_dbWinDataReady;
     Win32::MappedViewOfFile m_mappedViewOfFile;
     const DbWinBuffer* m_dbWinBuffer;
+    std::mutex m_processNamesMutex;
+    std::unordered_map<DWORD, std::string> m_processNames;
+
+    // single producer (the capture thread), single consumer (Notify) ring
+    std::vector<DBWinMessage> m_messages;
+    std::atomic<size_t> m_writeIndex;
+    std::atomic<size_t> m_readIndex;
+    Win32::Handle m_messagesAvailable;
+    Win32::Handle m_messagesRead;
+    Win32::Handle m_stopCapture;
+    std::atomic<uint64_t> m_stallMicroseconds;
+    std::atomic<size_t> m_ringFullCount;
+    std::thread m_captureThread;
 };
 
 } // namespace debugviewpp
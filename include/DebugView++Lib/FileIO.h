@@ -8,6 +8,7 @@
 #pragma once
 
 #include <iosfwd>
+#include <string_view>
 #include "DebugView++Lib/Line.h"
 
 namespace fusion {
@@ -57,7 +58,7 @@ struct OpenMode
 };
 
 void OpenLogFile(std::ofstream& ofstream, const std::wstring& filename, OpenMode::type mode = OpenMode::Truncate);
-void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, const std::string& processName, std::string message);
+void WriteLogFileMessage(std::ofstream& ofstream, double time, FILETIME filetime, DWORD pid, std::string_view processName, std::string_view message);
 
 } // namespace debugviewpp
 } // namespace fusion
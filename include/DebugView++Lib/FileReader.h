@@ -30,6 +30,7 @@ public:
 
     void Abort() override;
     HANDLE GetHandle() const override;
+    bool AllowsBlocking() const override;
     void Notify() override;
     void PreProcess(Line& line) const override;
 
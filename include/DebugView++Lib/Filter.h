@@ -8,11 +8,13 @@
 #pragma once
 
 #include <string>
+#include <string_view>
 #include <regex>
 #include <vector>
 #include <unordered_map>
 #include "MatchType.h"
 #include "FilterType.h"
+#include "LiteralMatcher.h"
 
 #pragma comment(lib, "DebugView++Lib.lib")
 
@@ -28,6 +30,7 @@ struct Filter
 
     std::string text;
     std::regex re;
+    LiteralSearch required; // a literal that every match of re contains, a text without it is not searched
     MatchType::type matchType;
     FilterType::type filterType;
     COLORREF bgColor;
@@ -36,19 +39,64 @@ struct Filter
     bool matched;
 };
 
+// the enabled Simple filters of a filter list compiled into one LiteralMatcher, so one pass over a text
+// finds all of them. Update() only rebuilds the matcher when these filters changed.
+class SimpleFilters
+{
+public:
+    void Update(const std::vector<Filter>& filters);
+
+    // hits[i] is set when filters[i] is an enabled Simple filter that occurs in text
+    void Find(std::string_view text, std::vector<char>& hits) const;
+
+private:
+    std::vector<std::string> m_texts; // per filter, the texts of the other filters are not used
+    std::vector<bool> m_simple;
+    std::vector<size_t> m_filterIndexes; // per pattern
+    LiteralMatcher m_matcher;
+};
+
 struct LogFilter
 {
     std::vector<Filter> messageFilters;
     std::vector<Filter> processFilters;
 };
 
+// a text with the Simple filters of a filter list that occur in it, from SimpleFilters::Find().
+// Without hits every filter is searched with its std::regex.
+struct FilterText
+{
+    explicit FilterText(std::string_view text, const std::vector<char>* pHits = nullptr);
+
+    std::string_view text;
+    const std::vector<char>* pHits;
+};
+
 void SaveFilterSettings(const std::vector<Filter>& filters, CRegKey& reg);
 void LoadFilterSettings(std::vector<Filter>& filters, CRegKey& reg);
 
-bool IsIncluded(std::vector<Filter>& filters, const std::string& text, MatchColors& matchColors);
-bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, const std::string& text);
+// std::regex_search() behind the required literal of the filter
+bool IsMatch(const Filter& filter, std::string_view text);
+
+bool IsIncluded(std::vector<Filter>& filters, std::string_view text, MatchColors& matchColors);
+bool IsIncluded(std::vector<Filter>& filters, const FilterText& text, MatchColors& matchColors);
+bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, std::string_view text);
+bool MatchFilterType(const std::vector<Filter>& filters, FilterType::type type, const FilterText& text);
+
+// the Once filters match again, as after the view was cleared
+void ResetMatched(std::vector<Filter>& filters);
+
+// only the enabled Include filters restrict the included texts, a Once filter only adds its first match
+bool HasIncludeFilters(const std::vector<Filter>& filters);
+
+// IsIncluded() without side effects, a Once filter that may not have matched yet counts as an Include filter
+bool MayBeIncluded(const std::vector<Filter>& filters, std::string_view text);
+
+// with Include filters, the texts of the enabled Include and Once filters when these are all Simple filters,
+// an included text contains one of them. Empty when this does not restrict the included texts.
+std::vector<std::string> GetIncludeTexts(const std::vector<Filter>& filters);
 
-std::string MatchKey(const std::smatch& match, MatchType::type matchType);
+std::string MatchKey(const std::cmatch& match, MatchType::type matchType);
 
 // Temporary backward compatibilty for loading FilterType::MatchColor:
 Filter MakeFilter(const std::string& text, MatchType::type matchType, FilterType::type filterType, COLORREF bgColor = RGB(255, 255, 255), COLORREF fgColor = RGB(0, 0, 0), bool enable = true, bool matched = false);
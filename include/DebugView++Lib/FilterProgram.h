@@ -0,0 +1,102 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <array>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DebugView++Lib/Filter.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// the decisions of all filters of a LogFilter for one message
+struct FilterResult
+{
+    enum Flags : unsigned
+    {
+        Include = 1 << 0,
+        Exclude = 1 << 1, // an Exclude filter matched
+        Bookmark = 1 << 2,
+        Stop = 1 << 3,
+        Track = 1 << 4,
+        Beep = 1 << 5,
+        Clear = 1 << 6,
+        Color = 1 << 7, // only asks for the color index
+        All = 0xff
+    };
+
+    unsigned flags = 0;
+    int color = -1; // the filter that colors an included line: an index in messageFilters, or messageFilters.size() + an index in processFilters
+};
+
+// a LogFilter compiled so Run() evaluates each enabled filter at most once per text: the Simple filters in one
+// LiteralMatcher pass, the other filters with their std::regex when first needed.
+// Where any filter of a type decides, like Exclude, the filters are tried cheapest first by their observed
+// cost and match rate. Run() changes the Once filters and the auto colors like IsIncluded() does,
+// a Clear filter that matches resets them before the line is filtered.
+class FilterProgram
+{
+public:
+    FilterProgram();
+
+    // rebuilds the program when the filters changed
+    void Update(const LogFilter& filter);
+
+    // evaluates the flags in 'wanted', the program must be updated for these filters
+    FilterResult Run(LogFilter& filter, std::string_view text, std::string_view processName, MatchColors& matchColors, unsigned wanted = FilterResult::All);
+
+private:
+    struct Key
+    {
+        std::string text;
+        MatchType::type matchType;
+        FilterType::type filterType;
+        bool enable;
+        bool autoColor;
+
+        bool operator==(const Key& key) const;
+    };
+
+    struct Statistics
+    {
+        size_t evaluations = 0;
+        size_t searches = 0; // the text contained the required literal
+        size_t matches = 0;
+    };
+
+    // the filters of one list, applied to one text at a time
+    struct Field
+    {
+        std::vector<Key> keys;
+        SimpleFilters simpleFilters;
+        std::array<std::vector<size_t>, FilterType::Bookmark + 1> types; // the enabled filters of each type
+        std::vector<size_t> autoColors;
+        std::vector<size_t> colors; // in the order CLogView::GetTextColor() tries them
+        std::vector<Statistics> statistics;
+        std::vector<char> hits;
+        std::vector<signed char> matches; // per filter, -1 until evaluated for the current text
+    };
+
+    static bool Update(Field& field, const std::vector<Filter>& filters);
+    static void Begin(Field& field, std::string_view text);
+    static bool Match(Field& field, const std::vector<Filter>& filters, size_t i, std::string_view text);
+    static bool MatchAny(Field& field, const std::vector<Filter>& filters, FilterType::type type, std::string_view text);
+    static bool IsIncluded(Field& field, std::vector<Filter>& filters, std::string_view text, MatchColors& matchColors, bool& excluded);
+    static int FindColor(Field& field, const std::vector<Filter>& filters, std::string_view text);
+    static void Reorder(Field& field, const std::vector<Filter>& filters);
+
+    Field m_message;
+    Field m_process;
+    Field m_processText; // the process filters on the message text, Beep filters are matched that way
+    size_t m_runs;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,108 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include "DebugView++Lib/Filter.h"
+#include "DebugView++Lib/FilterProgram.h"
+#include "DebugView++Lib/FilterStage.h"
+#include "DebugView++Lib/LogFile.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// how a change of the filters changes the included lines
+struct FilterEdit
+{
+    enum type
+    {
+        Narrowing, // only lines that were included before can be included
+        Widening,  // the lines that were included stay included, KeepsColor() tells whether with the same color
+        Arbitrary
+    };
+};
+
+FilterEdit::type ClassifyFilterEdit(const LogFilter& before, const LogFilter& after);
+
+// after a widening edit, an included line with this FilterResult::color has the same color with the 'after' filters
+bool KeepsColor(const LogFilter& before, const LogFilter& after, int color);
+
+// the lines that can pass the filter, only the Include filters restrict them
+LineQuery GetFilterQuery(const LogFilter& filter);
+
+// filters the lines of a LogFile from beginLine on in steps, so a re-filter of a large log can show progress and be cancelled.
+// A step reads a chunk of candidate lines for every thread of the FilterStage, the chunks are filtered in parallel.
+// Each chunk starts without matched Once filters and auto colors, the merge in line order evaluates the lines again
+// where a Once filter matched first in its chunk or a Clear filter matched. So the results equal filtering all lines one by one.
+// The lines added to the LogFile after the scan started get all FilterMatch flags, also when they only clear the view.
+class FilterScan
+{
+public:
+    FilterScan(const LogFile& logFile, const LogFilter& filter, LineQuery query, int beginLine, size_t chunks, size_t chunkLines = 4096);
+
+    // filters the next chunks and appends the included lines to matches. filter holds the Once filters matched before,
+    // it must have the filters the scan was created with. Returns false when the scan reached LogFile::EndIndex().
+    bool Step(FilterStage& stage, LogFilter& filter, FilterProgram& program, MatchColors& matchColors, std::vector<FilterMatch>& matches);
+
+    int GetLine() const; // the first line that was not scanned yet
+
+    // for a narrowing edit: before endLine only the sorted lines are read
+    void SetCandidates(std::vector<int> lines, int endLine);
+
+    // for a widening edit of filters without Once filters: the sorted matches before endLine are included as they are,
+    // their lines are not read
+    void SetIncluded(std::vector<FilterMatch> matches, int endLine);
+
+private:
+    // after the line at index, some Once filter of the chunk matched for the first time or a Clear filter matched
+    struct OnceMatch
+    {
+        size_t index;
+        std::vector<char> matched; // the matched flags of the chunk filter, message filters first
+    };
+
+    struct Chunk
+    {
+        LogFilter filter;
+        FilterProgram program;
+        MatchColors matchColors;
+        size_t count = 0; // the used entries of lines, texts and messages
+        int endLine = 0;  // the lines before endLine were read
+        std::vector<int> lines;
+        std::vector<std::string> texts; // LogFile::GetMessageRef() texts change with the next call, the messages refer to these copies
+        std::vector<MessageRef> messages;
+        std::vector<FilterMatch> matches;
+        std::vector<OnceMatch> onceMatches;
+    };
+
+    void ReadChunk(Chunk& chunk);
+    void FilterChunk(Chunk& chunk) const;
+    void MergeChunk(Chunk& chunk, LogFilter& filter, FilterProgram& program, MatchColors& matchColors, std::vector<FilterMatch>& matches) const;
+    void MergeOnceMatches(Chunk& chunk, LogFilter& filter, FilterProgram& program, MatchColors& matchColors, std::vector<FilterMatch>& matches) const;
+    void AddIncluded(int endLine, std::vector<FilterMatch>& matches, size_t begin);
+    unsigned GetWanted(int line) const;
+
+    const LogFile& m_logFile;
+    LineQuery m_query;
+    LineRange m_candidates;
+    int m_line;
+    size_t m_chunkLines;
+    bool m_once; // the filters have Once filters
+    std::vector<Chunk> m_chunks;
+    std::vector<int> m_lines;
+    size_t m_nextLine;
+    int m_linesEnd;
+    std::vector<FilterMatch> m_included;
+    size_t m_nextIncluded;
+    int m_includedEnd;
+    int m_liveLine; // LogFile::EndIndex() when the scan started
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,83 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <exception>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "DebugView++Lib/Filter.h"
+#include "DebugView++Lib/FilterProgram.h"
+#include "DebugView++Lib/LogFile.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+// what the filters of one view decided for one line.
+// Lines that are neither included nor clear the view are left out of the results.
+struct FilterMatch
+{
+    int line;
+    bool clear;    // the view is cleared before this line
+    bool included;
+    bool beep;
+    bool bookmark;
+    bool stop;
+    bool track;
+    int color;     // FilterResult::color of an included line
+};
+
+// adds the match of a line that is included or clears the view, the flags that were not evaluated stay false
+void AddFilterMatch(int line, const FilterResult& result, std::vector<FilterMatch>& matches);
+
+// evaluates the filters of one view for messages[begin, end), messages[begin] being line firstLine.
+// The lines are evaluated in order, so Once filters and auto colors change as when the lines are added one by one.
+// The program is kept per view so its filter order carries over to the next batch.
+void FilterMessages(LogFilter& filter, FilterProgram& program, MatchColors& matchColors, const std::vector<MessageRef>& messages, size_t begin, size_t end, int firstLine, std::vector<FilterMatch>& matches);
+
+// runs one job per view on worker threads and on the calling thread.
+// Run() returns when all jobs are done, so a job can use the state of its view while the UI thread waits.
+class FilterStage
+{
+public:
+    explicit FilterStage(size_t threads = DefaultThreadCount());
+    ~FilterStage();
+
+    FilterStage(const FilterStage&) = delete;
+    FilterStage& operator=(const FilterStage&) = delete;
+
+    static size_t DefaultThreadCount();
+    size_t GetThreadCount() const;
+
+    // calls job(0) .. job(count - 1), each exactly once. The first exception thrown by a job is rethrown.
+    void Run(size_t count, const std::function<void(size_t)>& job);
+
+private:
+    void Worker();
+    void RunJobs();
+
+    std::mutex m_mutex; // protects the members below, m_job and m_count do not change while a worker has joined
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(size_t)>* m_job = nullptr;
+    size_t m_count = 0;
+    size_t m_wanted = 0; // workers that may join the current run
+    size_t m_joined = 0;
+    size_t m_busy = 0;
+    std::exception_ptr m_exception;
+    bool m_end = false;
+
+    std::atomic<size_t> m_next;
+    std::vector<std::thread> m_threads;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -48,5 +48,8 @@ const wchar_t* EnumToWCharPtr(FilterType::type value);
 
 FilterType::type StringToFilterType(const std::string& s);
 
+// the filter types whose colors are applied to the lines they match
+bool FilterSupportsColor(FilterType::type value);
+
 } // namespace debugviewpp
 } // namespace fusion
@@ -0,0 +1,43 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <cstddef>
+
+namespace fusion {
+namespace debugviewpp {
+
+// sizes the batches of lines processed in one update so the update ends within its time budget.
+// The cost per line is measured on every batch, so the batch size follows the number of views and filters.
+// Times are in seconds on any monotonic clock.
+class FrameBudget
+{
+public:
+    explicit FrameBudget(double budget = 0.008, size_t minBatch = 64, size_t maxBatch = 50000);
+
+    void BeginFrame(double now);
+
+    // lines to process next, 0 when the budget of the frame is used. The first batch of a frame is never empty
+    [[nodiscard]] size_t NextBatch(double now) const;
+    void EndBatch(size_t lines, double seconds);
+
+    [[nodiscard]] double GetBudget() const;
+    [[nodiscard]] double GetLineCost() const; // smoothed seconds per line
+
+private:
+    double m_budget;
+    size_t m_minBatch;
+    size_t m_maxBatch;
+    double m_lineCost;
+    double m_frameStart;
+    size_t m_frameBatches;
+    size_t m_lastBatch;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 
@@ -15,6 +16,14 @@ namespace debugviewpp {
 
 class LogSource;
 
+// stamped on the lines of a LogSource, when the source is destroyed the generation of its slot moves on.
+// Slot 0 is never used, it identifies lines without a source.
+struct SourceId
+{
+    uint32_t slot = 0;
+    uint32_t generation = 0;
+};
+
 struct Line
 {
     Line(double time, FILETIME systemTime, HANDLE handle, const std::string& message, const LogSource* pLogSource);
@@ -33,6 +42,8 @@ struct Line
     std::string processName;
     std::string message;
     const LogSource* pLogSource;
+    SourceId sourceId;
+    FILETIME processStartTime; // zero when unknown
 };
 
 using Lines = std::vector<Line>;
@@ -0,0 +1,74 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include "DebugView++Lib/Line.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+class LogSource;
+
+// non-owning view on a line of a LineBatch, valid until the next Add(), EraseFront() or Clear() of the batch.
+struct LineRef
+{
+    double time;
+    FILETIME systemTime;
+    DWORD pid;
+    std::string_view processName;
+    std::string_view message;
+    const LogSource* pLogSource;
+    FILETIME processStartTime; // zero when unknown
+};
+
+// lines stored as records pointing into one char arena.
+// Clear() keeps the capacity, a batch that is reused for every update does not allocate once it has grown to the typical batch size.
+class LineBatch
+{
+public:
+    LineBatch();
+
+    [[nodiscard]] bool Empty() const;
+    [[nodiscard]] size_t Count() const;
+    void Clear();
+    // takes all fields but the message from 'line'
+    void Add(const Line& line, std::string_view message);
+    void Add(double time, FILETIME systemTime, DWORD pid, std::string_view processName, std::string_view message, const LogSource* pLogSource);
+    LineRef operator[](size_t i) const;
+    // drops the first 'count' lines
+    void EraseFront(size_t count);
+    // bytes reserved for the text of the lines
+    [[nodiscard]] size_t GetArenaCapacity() const;
+
+private:
+    struct Record
+    {
+        double time;
+        FILETIME systemTime;
+        DWORD pid;
+        const LogSource* pLogSource;
+        FILETIME processStartTime;
+        size_t processNameOffset;
+        size_t processNameSize;
+        size_t messageOffset;
+        size_t messageSize;
+    };
+
+    size_t Append(std::string_view text);
+    std::string_view GetText(size_t offset, size_t size) const;
+
+    std::vector<char> m_arena;
+    std::vector<Record> m_records;
+    size_t m_processNameRecord; // the last record that added its process name to the arena
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -0,0 +1,61 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include "Win32/Win32Lib.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+class LogSource;
+
+// waits for the handles of up to maxSources sources on its own thread and calls Notify() for every
+// signaled source, so the Notify() calls of one source are never concurrent and its lines stay in order.
+// Add() and Remove() only queue a membership change, the shard thread applies it between two waits.
+class ListenerShard
+{
+public:
+    static const size_t maxSources = MAXIMUM_WAIT_OBJECTS - 1; // one handle is taken by the wake event
+
+    explicit ListenerShard(std::function<void()> onNotify);
+    ~ListenerShard();
+
+    ListenerShard(const ListenerShard&) = delete;
+    ListenerShard& operator=(const ListenerShard&) = delete;
+
+    size_t Count() const;
+    void Add(LogSource* pSource);
+    void Remove(LogSource* pSource);
+
+    // blocks until the shard thread has applied all queued changes, a removed source is no longer used after this
+    void Synchronize();
+
+private:
+    void Run();
+    bool ApplyChanges(std::vector<HANDLE>& handles, std::vector<LogSource*>& sources);
+
+    std::function<void()> m_onNotify;
+    Win32::Handle m_wakeEvent;
+
+    mutable std::mutex m_mutex; // protects the members below
+    std::condition_variable m_applied;
+    std::vector<LogSource*> m_members;
+    size_t m_revision = 0;
+    size_t m_appliedRevision = 0;
+    bool m_end = false;
+
+    std::thread m_thread;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
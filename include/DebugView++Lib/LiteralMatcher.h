@@ -0,0 +1,63 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace fusion {
+namespace debugviewpp {
+
+// Aho-Corasick automaton that finds which of a set of literal patterns occur in a text in one pass.
+// The transitions are a dense table over the byte classes of the patterns, every text byte costs one lookup.
+// ignoreCase folds ASCII letters only, like std::regex::icase in the "C" locale.
+class LiteralMatcher
+{
+public:
+    LiteralMatcher();
+    explicit LiteralMatcher(const std::vector<std::string>& patterns, bool ignoreCase = true);
+
+    [[nodiscard]] bool Empty() const;
+    [[nodiscard]] size_t Count() const;
+
+    // found[id] is set for every pattern id that occurs in text, found is resized to Count()
+    void Find(std::string_view text, std::vector<char>& found) const;
+
+private:
+    size_t m_count;
+    size_t m_classCount;
+    std::array<uint16_t, 256> m_classes; // class 0 is every byte that is in no pattern
+    std::vector<uint32_t> m_next;        // [state * m_classCount + class]
+    std::vector<uint32_t> m_outputBegin; // the pattern ids of state s are m_outputs[m_outputBegin[s], m_outputBegin[s + 1])
+    std::vector<uint32_t> m_outputs;
+    std::vector<uint32_t> m_emptyPatterns; // occur in every text
+};
+
+// finds one literal in a text, with SSE2 the first and the last byte of the literal are compared at 16 text positions at once.
+// The empty literal is in every text.
+class LiteralSearch
+{
+public:
+    LiteralSearch();
+    LiteralSearch(const std::string& literal, bool ignoreCase);
+
+    [[nodiscard]] bool Empty() const;
+    [[nodiscard]] bool IsIn(std::string_view text) const;
+
+private:
+    bool Equals(const char* text) const;
+
+    std::string m_literal; // in lower case when m_ignoreCase
+    bool m_ignoreCase;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
@@ -7,8 +7,13 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
 #include <vector>
+#include <deque>
+#include <functional>
+#include <limits>
 #include "DebugView++Lib/Colors.h"
 #include "DebugView++Lib/ProcessInfo.h"
 #include "IndexedStorageLib/IndexedStorage.h"
@@ -26,21 +31,75 @@ struct Message
     std::string processName;
     std::string text;
     COLORREF color;
+    FILETIME processStartTime; // zero when unknown, tells a process from an earlier one with the same pid
 };
 
+// non-owning view on a message, processName stays valid until LogFile::Clear(),
+// text stays valid until the next call of another LogFile member function.
+struct MessageRef
+{
+    MessageRef(double time, FILETIME systemTime, DWORD pid, std::string_view processName, std::string_view msg, COLORREF color = Colors::BackGround);
+    explicit MessageRef(const Message& msg);
+
+    double time;
+    FILETIME systemTime;
+    DWORD processId;
+    std::string_view processName;
+    std::string_view text;
+    COLORREF color;
+    FILETIME processStartTime; // zero when unknown
+};
+
+// what a scan over the lines looks for, a default LineQuery matches every line.
+// LogFile skips blocks of lines of which its per block synopsis proves that no line can match.
+struct LineQuery
+{
+    std::vector<std::string> textAnyOf;                              // the text contains one of these, ASCII case insensitive
+    std::function<bool(std::string_view processName)> processFilter; // accepts the process name
+    double beginTime = -std::numeric_limits<double>::infinity();     // time is in [beginTime, endTime]
+    double endTime = std::numeric_limits<double>::infinity();
+};
+
+struct LineRange
+{
+    int begin;
+    int end;
+};
+
+// line indices keep counting up when the history size drops old lines,
+// only lines in [BeginIndex(), EndIndex()) can be accessed.
 class LogFile
 {
 public:
     bool Empty() const;
     void Clear();
     void Add(const Message& msg);
+    void Add(const MessageRef& msg);
     void Append(const LogFile& logfile, int beginIndex, int endIndex);
     int BeginIndex() const;
     int EndIndex() const;
     int Count() const;
     Message operator[](int i) const;
+    MessageRef GetMessageRef(int i) const;
+    void Prefetch(int beginIndex, int endIndex) const;
+    // call for every line of a sequential scan, the lines ahead of the scan are decoded in the background
+    void PrefetchAhead(int index) const;
+    // 0 means unlimited, otherwise at least 'size' lines are kept. Older lines are dropped a storage block at a time,
+    // so up to a block more are kept: 32 kB of text, or 4096 lines of short text.
     int GetHistorySize() const;
     void SetHistorySize(int size);
+    // false when line 'index' lies in a block of lines of which no line can match the query
+    bool MayMatch(int index, const LineQuery& query) const;
+    // the first run of lines from 'index' on that may match the query, lines skipped before it cannot match.
+    // begin is EndIndex() when no further line can match.
+    LineRange NextCandidates(int index, const LineQuery& query) const;
+    // the first line with a time not before 'time', EndIndex() if there is none.
+    // Takes O(log n) and assumes the times ascend with the line index.
+    int LowerBoundByTime(double time) const;
+    int LowerBoundBySystemTime(const FILETIME& systemTime) const;
+    // bytes of compressed lines kept in memory, older lines are moved to a scratch file. 0 means unlimited.
+    size_t GetMemoryBudget() const;
+    void SetMemoryBudget(size_t bytes);
 
 private:
     struct InternalMessage
@@ -57,11 +116,40 @@ private:
         DWORD uid;
     };
 
-    std::vector<InternalMessage> m_messages;
+    // metadata of a range of lines aligned to a multiple of its size. The zone map is kept for the
+    // lookups by time and to skip blocks in scans, the text of the lines is summarized by the storage blocks.
+    struct MetadataBlock
+    {
+        explicit MetadataBlock(const InternalMessage& msg);
+
+        double minTime;
+        double maxTime;
+        uint64_t maxSystemTime;
+        std::vector<DWORD> uids;
+        bool anyProcess;     // set instead of growing uids beyond a limit
+        std::string columns; // time, system time and uid columns, encoded when the block is full
+    };
+
+    void EnforceHistorySize();
+    void CompactProcesses();
+    void AddMetadata(const InternalMessage& msg);
+    const MetadataBlock& GetBlock(int index) const;
+    int GetBlockEnd(int index) const;
+    const InternalMessage& GetMetadata(int index) const;
+    template <typename BlockBefore, typename LineBefore>
+    int LowerBound(BlockBefore blockBefore, LineBefore lineBefore) const;
+
+    std::deque<MetadataBlock> m_blocks;
+    std::vector<InternalMessage> m_writeMessages;        // metadata of the last block until it is full
+    mutable std::vector<InternalMessage> m_readMessages; // decoded columns of block m_readBlock
+    mutable int m_readBlock = -1;
     ProcessInfo m_processInfo;
     mutable indexedstorage::SnappyStorage m_storage;
     //    indexedstorage::VectorStorage m_storage;
+    int m_beginIndex = 0;
+    int m_endIndex = 0;
     int m_historySize = 0;
+    size_t m_compactedProcesses = 0;
 };
 
 } // namespace debugviewpp
@@ -7,6 +7,7 @@
 
 #pragma once
 
+#include <atomic>
 #include "DebugView++Lib/Line.h"
 #include "DebugView++Lib/SourceType.h"
 #include "Win32/Utilities.h"
@@ -46,13 +47,29 @@ public:
     // typically used to set the processname
     virtual void PreProcess(Line& line) const;
 
+    // called when a process of which a line was added with its handle has ended
+    virtual void OnProcessEnded(DWORD pid);
+
+    // true when adding a line may wait for room in the line buffer, so the producer of the lines is slowed down
+    virtual bool AllowsBlocking() const;
+
+    // lines of this source the line buffer dropped because its ingest budget was exhausted
+    size_t GetDroppedLines() const;
+    void AddDroppedLine() const;
+
     std::wstring GetDescription() const;
     void SetDescription(const std::wstring& description);
 
     SourceType::type GetSourceType() const;
 
+    // stays unique after this source is destroyed, so lines can outlive their source
+    SourceId GetSourceId() const;
+    // true while the source that added a line with this id exists, takes a single array lookup
+    static bool Exists(SourceId id);
+
     // for DBWIN messages
     void Add(HANDLE handle, const std::string& message) const;
+    void Add(double time, FILETIME systemTime, HANDLE handle, const std::string& message) const;
 
     // for Loopback messages and DBWIN kernel message that have no PID
     void Add(DWORD pid, const std::string& processName, const std::string& message);
@@ -66,6 +83,10 @@ public:
     // used by FileReader
     void Add(const std::string& message);
 
+protected:
+    // the time on the timer shared by all sources
+    double GetTime() const;
+
 private:
     bool m_autoNewLine = true;
     ILineBuffer& m_linebuffer;
@@ -73,6 +94,8 @@ private:
     SourceType::type m_sourceType;
     Timer& m_timer;
     bool m_end = false;
+    SourceId m_sourceId;
+    mutable std::atomic<size_t> m_droppedLines;
 };
 
 } // namespace debugviewpp
@@ -8,13 +8,16 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include <boost/signals2.hpp>
 #include "Win32/Win32Lib.h"
 #include "DebugView++Lib/LogSource.h"
-#include "DebugView++Lib/VectorLineBuffer.h"
+#include "DebugView++Lib/RingLineBuffer.h"
 #include "CobaltFusion/ExecutorClient.h"
 #include "DebugView++Lib/NewlineFilter.h"
+#include "DebugView++Lib/LineBatch.h"
 #include "DebugView++Lib/ProcessMonitor.h"
+#include "DebugView++Lib/ListenerShard.h"
 #include "CobaltFusion/Throttle.h"
 
 #pragma comment(lib, "DebugView++Lib.lib")
@@ -66,10 +69,16 @@ public:
     virtual void SetProcessPrefix(bool value);
     virtual bool GetProcessPrefix() const;
 
+    void SetIngestBudget(const IngestBudget& budget);
+    IngestBudget GetIngestBudget() const;
+    size_t GetDroppedLines() const;
+
     void ResetTimer();
     void Listen();
     void Abort();
-    bool IsRemoved(const LogSource* logsource) const;
+    bool IsRemoved(SourceId id) const;
+    // appends the new lines to 'lines', pass the same batch for every update to reuse its memory
+    void GetLines(LineBatch& lines);
     Lines GetLines();
     void Remove(LogSource* pLogSource);
     void RemoveSources(std::function<bool(LogSource*)> predicate);
@@ -90,7 +99,8 @@ public:
 
 private:
     void UpdateSources();
-    void ListenUntilUpdateEvent();
+    void AddToShard(LogSource* pSource);
+    void RemoveFromShards(const std::vector<LogSource*>& sources);
     void InternalRemove(LogSource*);
     void UpdateSettings(const std::unique_ptr<LogSource>& pSource);
     void Add(std::unique_ptr<LogSource> pSource);
@@ -104,11 +114,15 @@ private:
     std::vector<std::unique_ptr<LogSource>> m_sourcesScheduleToAdd;
     std::vector<LogSource*> m_sourcesScheduledToRemove;
 
+    // owned by the thread that calls Listen(), every listened source is in exactly one shard
+    std::vector<std::unique_ptr<ListenerShard>> m_shards;
+    std::unordered_map<LogSource*, ListenerShard*> m_sourceShards;
+
     bool m_autoNewLine = true;
     bool m_processPrefix = false;
     Win32::Handle m_updateEvent;
     bool m_end = false;
-    LineBuffer m_linebuffer;
+    RingLineBuffer m_linebuffer;
     PidMap m_pidMap;
     ProcessMonitor m_processMonitor;
     NewlineFilter m_newlineFilter;
@@ -34,6 +34,9 @@ struct MatchType
 
 std::string MakePattern(MatchType::type type, const std::string& text);
 
+// the longest literal that every match of an ECMAScript pattern contains, empty when none was found
+std::string GetRequiredLiteral(const std::string& pattern);
+
 int MatchTypeToInt(MatchType::type value);
 
 MatchType::type IntToMatchType(int value);
@@ -9,6 +9,7 @@
 
 #include <string>
 #include <unordered_map>
+#include "DebugView++Lib/LineBatch.h"
 
 namespace fusion {
 namespace debugviewpp {
@@ -18,7 +19,7 @@ struct Line;
 class NewlineFilter
 {
 public:
-    Lines Process(const Line& line);
+    void Process(const Line& line, LineBatch& lines);
     Lines FlushLinesFromTerminatedProcess(DWORD pid, HANDLE handle);
 
 private:
@@ -7,8 +7,12 @@
 
 #pragma once
 
+#include <cstdint>
 #include <string>
+#include <string_view>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
 
 #pragma comment(lib, "DebugView++Lib.lib")
 
@@ -22,6 +26,7 @@ struct InternalProcessProperties
 
     DWORD pid; // system processId
     std::wstring name;
+    std::string utf8Name; // name converted once, so readers can use it without conversion
     COLORREF color;
 };
 
@@ -43,14 +48,52 @@ public:
     static size_t GetPrivateBytes();
     static std::wstring GetProcessName(HANDLE handle);
     static std::wstring GetStartTime(HANDLE handle);
+    static FILETIME GetCreationTime(HANDLE handle);
     static std::wstring GetProcessNameByPid(DWORD processId);
 
+    // a process is identified by pid and name in O(1). A start time of 0 is unknown, a known start time
+    // that differs from the one seen before for the same pid and name means the pid was reused by a new process.
+    DWORD GetUid(DWORD processId, std::string_view processName, uint64_t startTime = 0);
     DWORD GetUid(DWORD processId, const std::wstring& processName);
     ProcessProperties GetProcessProperties(DWORD processId, const std::wstring& processName);
     ProcessProperties GetProcessProperties(DWORD uid) const;
 
+    // the reference stays valid until Clear() or Compact()
+    const InternalProcessProperties& GetProcessPropertiesRef(DWORD uid) const;
+
+    [[nodiscard]] size_t Count() const;
+
+    // drops the processes that are not in 'uids', the uids of the remaining processes do not change
+    void Compact(const std::vector<DWORD>& uids);
+
 private:
+    struct ProcessKey
+    {
+        DWORD pid;
+        std::string_view name; // refers to m_names, or to the searched name during a lookup
+    };
+
+    struct ProcessKeyHash
+    {
+        size_t operator()(const ProcessKey& key) const;
+    };
+
+    struct ProcessKeyEqual
+    {
+        bool operator()(const ProcessKey& a, const ProcessKey& b) const;
+    };
+
+    struct IndexEntry
+    {
+        DWORD uid;
+        uint64_t startTime;
+    };
+
+    std::string_view InternName(std::string_view name);
+
     std::unordered_map<DWORD, InternalProcessProperties> m_processProperties;
+    std::unordered_set<std::string> m_names; // interned process names, nodes do not move so views stay valid
+    std::unordered_map<ProcessKey, IndexEntry, ProcessKeyHash, ProcessKeyEqual> m_index; // latest uid per pid and name
     DWORD m_unqiueId;
 };
 
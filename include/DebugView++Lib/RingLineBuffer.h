@@ -0,0 +1,112 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "LineBuffer.h"
+
+namespace fusion {
+namespace debugviewpp {
+
+enum class IngestPolicy
+{
+    Block,      // the producer waits for room, sources that cannot wait drop their newest lines
+    DropOldest, // the oldest lines of the overflow list make room
+    DropNewest
+};
+
+// limits the lines and message bytes that wait in the buffer for the consumer, 0 means unlimited
+struct IngestBudget
+{
+    size_t maxLines = 1000 * 1000;
+    size_t maxBytes = 256 * 1024 * 1024;
+    IngestPolicy policy = IngestPolicy::Block;
+};
+
+// multi-producer, single-consumer line buffer. Producers claim slots of a fixed ring without taking a lock,
+// GetLines() moves the lines out of the ring in one batch. While the ring is full, lines go to a locked
+// overflow list until the consumer catches up.
+// Beyond the ingest budget lines are dropped or the producer waits, depending on the policy.
+// Dropped lines are counted per source and GetLines() reports each gap with a "N lines dropped" line.
+// Lines with a process handle are never dropped, so every handle reaches the consumer. An oldest line that is
+// dropped for the line of another source only counts in GetDroppedLines() of the buffer.
+class RingLineBuffer : public ILineBuffer
+{
+public:
+    // 'size' is the number of lines in the ring, rounded up to a power of 2
+    explicit RingLineBuffer(size_t size, const IngestBudget& budget = IngestBudget());
+
+    void SetBudget(const IngestBudget& budget);
+    IngestBudget GetBudget() const;
+
+    // the gap markers are added as internal lines of this source
+    void SetMarkerSource(const LogSource* pSource);
+
+    // producers waiting for room drop their line instead, and Add() does not wait anymore
+    void Abort();
+
+    [[nodiscard]] size_t GetDroppedLines() const;
+
+    void Add(double time, FILETIME systemTime, HANDLE handle, const std::string& message, const LogSource* pSource) override;
+    void Add(double time, FILETIME systemTime, DWORD pid, const std::string& processName, const std::string& message, const LogSource* pSource) override;
+    [[nodiscard]] Lines GetLines() override;
+    [[nodiscard]] bool Empty() const override;
+
+private:
+    struct Slot
+    {
+        std::atomic<size_t> sequence; // position + 1 when the line is written, position + capacity when it is free again
+        Line line;
+    };
+
+    // a line with 'dropped' > 0 only marks a gap
+    struct OverflowLine
+    {
+        Line line;
+        size_t dropped;
+    };
+
+    void Push(Line&& line);
+    bool TryPush(Line& line);
+    bool Reserve(const Line& line);
+    bool IsOverBudget(size_t bytes) const;
+    bool DropOldestOverflowLine(const LogSource* pProducer);
+    void Drop(const Line& line);
+    void Take(Line&& line, Lines& lines);
+    Line CreateMarker(size_t dropped) const;
+
+    size_t m_mask;
+    std::unique_ptr<Slot[]> m_slots;
+    alignas(64) std::atomic<size_t> m_writePosition;
+    alignas(64) std::atomic<size_t> m_readPosition; // only written by the consumer
+    std::atomic<bool> m_overflow;
+    std::mutex m_overflowMutex;
+    std::deque<OverflowLine> m_overflowLines;
+
+    std::atomic<size_t> m_maxLines;
+    std::atomic<size_t> m_maxBytes;
+    std::atomic<IngestPolicy> m_policy;
+    std::atomic<size_t> m_lines; // lines and message bytes in the ring and the overflow list
+    std::atomic<size_t> m_bytes;
+    std::atomic<size_t> m_droppedLines;
+    std::atomic<bool> m_aborted;
+    std::mutex m_roomMutex;
+    std::condition_variable m_room;
+
+    // only used by the consumer
+    const LogSource* m_pMarkerSource;
+    double m_lastTime;
+    FILETIME m_lastSystemTime;
+};
+
+} // namespace debugviewpp
+} // namespace fusion
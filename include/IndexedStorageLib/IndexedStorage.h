@@ -7,8 +7,14 @@
 
 #pragma once
 
+#include <cstdint>
 #include <vector>
+#include <deque>
 #include <string>
+#include <string_view>
+#include <list>
+#include <memory>
+#include <unordered_map>
 
 #pragma comment(lib, "IndexedStorageLib.lib")
 
@@ -20,40 +26,145 @@ class VectorStorage
 public:
     [[nodiscard]] bool Empty() const;
     void Clear();
-    size_t Add(const std::string& value);
+    size_t Add(std::string_view value);
     [[nodiscard]] size_t Count() const;
     std::string operator[](size_t i) const;
+
+    // the view is valid until the next Add() or Clear()
+    std::string_view View(size_t i) const;
     void shrink_to_fit();
 
 private:
     std::vector<std::string> m_storage;
 };
 
+using DecodedBlock = std::vector<std::string>;
+
+class BlockWorker;
+class ScratchFile;
+
 class SnappyStorage
 {
 public:
     SnappyStorage();
+    ~SnappyStorage();
+    SnappyStorage(SnappyStorage&&) noexcept;
+    SnappyStorage& operator=(SnappyStorage&&) noexcept;
 
     [[nodiscard]] bool Empty() const;
     void Clear();
-    size_t Add(const std::string& value);
+    size_t Add(std::string_view value);
     [[nodiscard]] size_t Count() const;
     std::string operator[](size_t i);
 
-    [[nodiscard]] std::string Compress(const std::vector<std::string>& value) const;
+    // returns the string without copying it, the decoded block it points into is pinned
+    // so the view is valid until the next call of a non-const member function.
+    std::string_view View(size_t i);
+
+    // indices returned by Add() keep counting up when blocks are removed from the front,
+    // only [BeginIndex(), EndIndex()) can be accessed.
+    [[nodiscard]] size_t BeginIndex() const;
+    [[nodiscard]] size_t EndIndex() const;
+
+    // a block is sealed when it holds blockBytes of string data and at least minLines strings,
+    // or when it holds maxLines strings. Only affects blocks sealed after the call.
+    void SetBlockLimits(size_t blockBytes, size_t minLines, size_t maxLines);
+
+    // number of strings in the oldest sealed block, 0 if no block is sealed yet
+    [[nodiscard]] size_t FrontBlockCount() const;
+
+    // removes the oldest sealed block in constant time and returns the number of strings removed
+    size_t PopFrontBlock();
+
+    // decodes the blocks holding the strings [beginIndex, endIndex] on a background thread
+    // so a following operator[] finds them in the block cache.
+    void Prefetch(size_t beginIndex, size_t endIndex);
+
+    // the block cache is bounded by the size of the decoded strings, it always holds at least one block
+    [[nodiscard]] size_t GetCacheSize() const;
+    void SetCacheSize(size_t bytes);
+
+    // full blocks are compressed on a background thread, Flush() waits until that is done
+    void Flush();
+
+    // returns false when no string in the block holding string 'index' contains 'text', compared ASCII case insensitive.
+    // Decided on a trigram bloom filter the worker builds with the compressed block, so the block is not decoded.
+    // Returns true for the write block, for blocks that are not compressed yet or have too many distinct trigrams to filter
+    // and for texts shorter than 3 characters.
+    [[nodiscard]] bool MayContain(size_t index, std::string_view text) const;
+
+    // index one past the last string of the block holding string 'index'
+    [[nodiscard]] size_t GetBlockEnd(size_t index) const;
+
+    // bytes held in memory by the sealed blocks, a block that is not compressed yet counts with its uncompressed size
+    [[nodiscard]] size_t GetStorageSize() const;
+
+    // when the sealed blocks in memory exceed the budget, the oldest compressed blocks are moved
+    // to a temporary scratch file and read back through a mapped view on access. 0 means unlimited.
+    [[nodiscard]] size_t GetMemoryBudget() const;
+    void SetMemoryBudget(size_t bytes);
+    [[nodiscard]] size_t GetSpilledSize() const;
+
+    [[nodiscard]] static std::string Compress(const std::vector<std::string>& value);
     static std::vector<std::string> Decompress(const std::string& value);
+    static std::vector<std::string> Decompress(const char* value, size_t size);
     void shrink_to_fit();
 
 private:
-    static size_t GetBlockIndex(size_t index);
-    static size_t GetRelativeIndex(size_t index);
-    std::string GetString(size_t index);
+    struct CacheEntry
+    {
+        CacheEntry(size_t blockIndex, std::shared_ptr<const DecodedBlock> block);
+
+        size_t blockIndex;
+        std::shared_ptr<const DecodedBlock> block;
+        size_t bytes;
+    };
+
+    struct Block
+    {
+        std::string compressed;
+        std::shared_ptr<const DecodedBlock> uncompressed; // set until the worker has compressed the block
+        std::vector<uint64_t> trigrams;                   // bloom filter, set by the worker with the compressed block
+        uint64_t spillOffset = 0;                         // location in the scratch file once spilled
+        size_t spillSize = 0;
+    };
 
+    size_t GetBlockIndex(size_t index) const;
+    size_t GetRelativeIndex(size_t index, size_t blockIndex) const;
+    const std::shared_ptr<const DecodedBlock>& GetBlock(size_t blockIndex);
+    bool FindCachedBlock(size_t blockIndex);
+    void InsertCachedBlock(size_t blockIndex, std::shared_ptr<const DecodedBlock> block);
+    void SealWriteBlock();
+    void SpillBlocks();
+    bool IsSpilled(size_t blockIndex) const;
+    BlockWorker& GetWorker();
+    void CollectWork();
+    void TrimCache();
+
+    size_t m_firstBlockIndex;
     size_t m_writeBlockIndex;
-    size_t m_readBlockIndex;
-    std::vector<std::string> m_readList;
+    size_t m_writeBeginIndex;
+    size_t m_writeBytes;
     std::vector<std::string> m_writeList;
-    std::vector<std::string> m_storage;
+    std::deque<Block> m_storage;
+    std::deque<size_t> m_blockBegin; // index of the first string of each block in m_storage
+    size_t m_storageBytes;
+
+    size_t m_memoryBudget;
+    size_t m_spilledBlocks; // the first m_spilledBlocks blocks of m_storage are in the scratch file
+    size_t m_spilledBytes;
+    std::shared_ptr<ScratchFile> m_scratchFile; // shared with decode jobs of the worker
+
+    size_t m_blockBytes;
+    size_t m_minBlockLines;
+    size_t m_maxBlockLines;
+
+    size_t m_cacheSize;
+    size_t m_cacheBytes;
+    std::list<CacheEntry> m_cache; // most recently used block first
+    std::unordered_map<size_t, std::list<CacheEntry>::iterator> m_cacheIndex;
+    std::shared_ptr<const DecodedBlock> m_pinnedBlock; // keeps the block of the last View() alive
+    std::unique_ptr<BlockWorker> m_worker;
 };
 
 } // namespace indexedstorage
@@ -0,0 +1,57 @@
+// (C) Copyright Gert-Jan de Vos and Jan Wilmans 2013.
+// Distributed under the Boost Software License, Version 1.0.
+// (See accompanying file LICENSE_1_0.txt or copy at
+// http://www.boost.org/LICENSE_1_0.txt)
+
+// Repository at: https://github.com/djeedjay/DebugViewPP/
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+namespace fusion {
+namespace indexedstorage {
+
+// LEB128 encoding, 7 bits per byte, small values take a single byte
+inline void PutVarint(std::string& data, uint64_t value)
+{
+    while (value >= 0x80)
+    {
+        data.push_back(static_cast<char>((value & 0x7F) | 0x80));
+        value >>= 7;
+    }
+    data.push_back(static_cast<char>(value));
+}
+
+inline uint64_t GetVarint(const char*& p)
+{
+    uint64_t value = 0;
+    int shift = 0;
+    for (;;)
+    {
+        auto c = static_cast<unsigned char>(*p++);
+        value |= static_cast<uint64_t>(c & 0x7F) << shift;
+        if (c < 0x80)
+        {
+            return value;
+        }
+        shift += 7;
+    }
+}
+
+// counters and timestamps change little between lines,
+// zigzag encoding keeps small negative deltas small
+inline uint64_t ZigZag(uint64_t delta)
+{
+    auto value = static_cast<int64_t>(delta);
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+inline uint64_t UnZigZag(uint64_t value)
+{
+    return (value >> 1) ^ (0 - (value & 1));
+}
+
+} // namespace indexedstorage
+} // namespace fusion